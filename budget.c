@@ -0,0 +1,452 @@
+/*****************************************************************************/
+/* budget.c - Fits the largest input prefix into a compressed size budget.   */
+/*            The input is encoded once and the token stream is walked to    */
+/*            find the last point where header + stream still fit, instead   */
+/*            of trial compressions with different -s values.  The chosen    */
+/*            prefix is then encoded for real, so the reported sizes and the */
+/*            emitted stream are exactly what a -s run would produce.        */
+/*****************************************************************************/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress_rtns.h"
+#include "incremental.h"
+#include "budget.h"
+
+static const int bud_types[3] = {BYTE_CMP_TYPE, SHORT_CMP_TYPE, LONG_CMP_TYPE};
+static const char* bud_typeNames[3] = {"8-bit", "16-bit", "32-bit"};
+
+
+
+
+/*****************************************************************************/
+/* bud_hdrBytes - Header size for a prefix of the input.                     */
+/* Returns: size in bytes, -1 if the prefix does not fit in the header.      */
+/*****************************************************************************/
+static int bud_hdrBytes(size_t prefixBytes, int cmprType, int forceHdrSize32){
+
+	char hdr[CMP_MAX_HDR_BYTES];
+
+	if(prefixBytes > CMP_MAX_HDR_SIZE)
+		return -1;
+
+	return cmp_build_header(cmprType,prefixBytes,forceHdrSize32,hdr);
+}
+
+
+
+
+/*****************************************************************************/
+/* bud_prefixBytes - Input bytes in a prefix of whole units.                 */
+/*****************************************************************************/
+static size_t bud_prefixBytes(size_t prefixUnits, size_t unitSize,
+							  size_t sizeBytes)
+{
+	if(prefixUnits > (sizeBytes / unitSize))
+		return sizeBytes;
+
+	return prefixUnits*unitSize;
+}
+
+
+
+
+/*****************************************************************************/
+/* bud_longest - Finds the longest prefix ending k units past unitPos, for   */
+/*               k in [minUnits, maxUnits], whose header and stream fit.     */
+/*               The stream is fixedBytes + k*perUnitBytes.  Header and      */
+/*               stream both grow with k, so a binary search is exact.       */
+/* Returns: k, or 0 if no such prefix fits.                                  */
+/*****************************************************************************/
+static size_t bud_longest(size_t unitPos, size_t minUnits, size_t maxUnits,
+						  size_t fixedBytes, size_t perUnitBytes, int cmprType,
+						  int forceHdrSize32, size_t sizeBytes,
+						  size_t budgetBytes, size_t capUnits)
+{
+	size_t unitSize = cmp_unit_size(cmprType);
+	size_t lo, hi, k, best;
+	int hdrBytes;
+
+	/* Prefixes must be shorter than capUnits */
+	hi = maxUnits;
+	if((unitPos + hi) >= capUnits)
+		hi = (capUnits > (unitPos + 1)) ? capUnits - unitPos - 1 : 0;
+	lo = minUnits;
+	best = 0;
+	while(lo <= hi){
+		k = lo + (hi - lo)/2;
+		hdrBytes = bud_hdrBytes(bud_prefixBytes(unitPos + k,unitSize,sizeBytes),
+			cmprType,forceHdrSize32);
+		if((hdrBytes >= 0) && ((hdrBytes + fixedBytes + k*perUnitBytes) <= budgetBytes)){
+			best = k;
+			lo = k + 1;
+		}
+		else
+			hi = k - 1;
+	}
+
+	return best;
+}
+
+
+
+
+/*****************************************************************************/
+/* bud_candidate - Walks a token stream for the longest prefix that fits.    */
+/*                 Prefixes end on a token boundary, or part way through a   */
+/*                 literal or run, which then shortens to fit.               */
+/* Inputs: pCmprData/cmprSizeBytes, stream for the first scanUnits of input  */
+/*         exact, non-zero if the stream covers the whole input, otherwise   */
+/*                tokens near the end of the scan are not trusted            */
+/*         capUnits, prefixes must be shorter than this                      */
+/*         prefixUnits, set to the prefix length in units (0 if none fit)    */
+/* Returns: 0 on success, -1 on a malformed stream.                          */
+/*****************************************************************************/
+static int bud_candidate(char* pCmprData, size_t cmprSizeBytes, int cmprType,
+						 int forceHdrSize32, size_t sizeBytes, size_t scanUnits,
+						 int exact, size_t budgetBytes, size_t capUnits,
+						 size_t* prefixUnits)
+{
+	size_t unitSize = cmp_unit_size(cmprType);
+	size_t unitPos, outPos, endUnit, tokUnits, tokBytes, k;
+	int resync, prevOpenLiteral, hdrBytes;
+
+	*prefixUnits = 0;
+	unitPos = outPos = 0;
+	prevOpenLiteral = 0;
+	while(outPos < cmprSizeBytes){
+		if(incr_parse_token(pCmprData + outPos,cmprSizeBytes - outPos,cmprType,
+			&tokUnits,&tokBytes,&resync) < 0)
+			return -1;
+		endUnit = unitPos + tokUnits;
+		if(!exact && ((endUnit + CMP_LOOKAHEAD_UNITS) > scanUnits))
+			break;
+
+		/* Header grows with the prefix, so size it for the token's end */
+		hdrBytes = bud_hdrBytes(bud_prefixBytes(endUnit,unitSize,sizeBytes),
+			cmprType,forceHdrSize32);
+		if((hdrBytes >= 0) && (endUnit < capUnits) &&
+			((hdrBytes + outPos + tokBytes) <= budgetBytes)){
+			*prefixUnits = endUnit;
+			unitPos = endUnit;
+			outPos += tokBytes;
+			prevOpenLiteral = (tokBytes == (tokUnits + 1)*unitSize) && !resync;
+			continue;
+		}
+
+		/* Part of a run.  A shorter run (or a single unit literal) costs */
+		/* the same stream bytes but may need a smaller header.          */
+		/* Otherwise the run's first unit can join a literal that can    */
+		/* still grow.                                                   */
+		if((tokBytes == 2*unitSize) && (tokUnits >= 2)){
+			k = bud_longest(unitPos,prevOpenLiteral ? 2 : 1,tokUnits - 1,
+				outPos + tokBytes,0,cmprType,forceHdrSize32,sizeBytes,
+				budgetBytes,capUnits);
+			if((k == 0) && prevOpenLiteral)
+				k = bud_longest(unitPos,1,1,outPos + unitSize,0,cmprType,
+					forceHdrSize32,sizeBytes,budgetBytes,capUnits);
+		}
+
+		/* Part of a literal, a count and k units */
+		else{
+			k = bud_longest(unitPos,1,tokUnits - 1,outPos + unitSize,unitSize,
+				cmprType,forceHdrSize32,sizeBytes,budgetBytes,capUnits);
+		}
+		if(k > 0)
+			*prefixUnits = unitPos + k;
+		break;
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* bud_partialUnit - Extends a whole unit prefix with as many bytes of the   */
+/*                   next unit as still fit.  A -s run zero pads the last    */
+/*                   unit, so the tail from the last resync point that the   */
+/*                   end of the prefix cannot affect is re-encoded from a    */
+/*                   zero padded copy and joined to the existing stream.     */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int bud_partialUnit(char* pData, size_t sizeBytes, int cmprType,
+						   int forceHdrSize32, size_t budgetBytes,
+						   size_t* prefixBytes, char** pCmprBuf,
+						   size_t* cmprSizeBytes)
+{
+	char* pTail, *pTailBuf, *pNewBuf;
+	size_t unitSize = cmp_unit_size(cmprType);
+	size_t wholeUnits, unitPos, outPos, resyncUnits, resyncOut;
+	size_t tokUnits, tokBytes, extraBytes, tailBytes, tailCmprBytes;
+	int resync, hdrBytes, rval;
+
+	if((unitSize == 1) || (*prefixBytes >= sizeBytes))
+		return 0;
+	wholeUnits = *prefixBytes / unitSize;
+
+	/* Tokens ending 2 units before the end are the same either way */
+	unitPos = outPos = resyncUnits = resyncOut = 0;
+	while(outPos < *cmprSizeBytes){
+		if(incr_parse_token(*pCmprBuf + CMP_MAX_HDR_BYTES + outPos,
+			*cmprSizeBytes - outPos,cmprType,&tokUnits,&tokBytes,&resync) < 0)
+			return -1;
+		unitPos += tokUnits;
+		outPos += tokBytes;
+		if((unitPos + CMP_LOOKAHEAD_UNITS) > wholeUnits)
+			break;
+		if(resync){
+			resyncUnits = unitPos;
+			resyncOut = outPos;
+		}
+	}
+
+	/* Zero padded copy of the input from the resync point */
+	extraBytes = sizeBytes - *prefixBytes - 1;
+	if(extraBytes > (unitSize - 1))
+		extraBytes = unitSize - 1;
+	tailBytes = *prefixBytes - resyncUnits*unitSize;
+	pTail = (char*)calloc(tailBytes + unitSize + CMP_UNIT_PAD_BYTES,1);
+	if(pTail == NULL){
+		printf("Error allocating memory for budget fit\n");
+		return -1;
+	}
+	memcpy(pTail,pData + resyncUnits*unitSize,tailBytes + extraBytes);
+
+	/* Longest partial unit first, zeroing each byte that does not fit */
+	rval = 0;
+	for(; extraBytes > 0; extraBytes--){
+		hdrBytes = bud_hdrBytes(*prefixBytes + extraBytes,cmprType,forceHdrSize32);
+		if(hdrBytes >= 0){
+			if(cmp_encode(pTail,tailBytes + extraBytes,cmprType,&pTailBuf,
+				&tailCmprBytes) < 0){
+				rval = -1;
+				break;
+			}
+			if((hdrBytes + resyncOut + tailCmprBytes) <= budgetBytes){
+				pNewBuf = (char*)malloc(CMP_MAX_HDR_BYTES + resyncOut + tailCmprBytes);
+				if(pNewBuf == NULL){
+					printf("Error allocating memory for budget fit\n");
+					free(pTailBuf);
+					rval = -1;
+					break;
+				}
+				if(resyncOut > 0)
+					memcpy(pNewBuf + CMP_MAX_HDR_BYTES,*pCmprBuf + CMP_MAX_HDR_BYTES,
+						resyncOut);
+				memcpy(pNewBuf + CMP_MAX_HDR_BYTES + resyncOut,
+					pTailBuf + CMP_MAX_HDR_BYTES,tailCmprBytes);
+				free(pTailBuf);
+				free(*pCmprBuf);
+				*pCmprBuf = pNewBuf;
+				*cmprSizeBytes = resyncOut + tailCmprBytes;
+				*prefixBytes += extraBytes;
+				break;
+			}
+			free(pTailBuf);
+		}
+		pTail[tailBytes + extraBytes - 1] = 0;
+	}
+	free(pTail);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* bud_fit - Finds and encodes the longest input prefix whose header and     */
+/*           compressed stream fit in a budget.                              */
+/* Inputs: pData/sizeBytes, input (zero padded to a whole 32-bit unit)       */
+/*         cmprType, BYTE_CMP_TYPE, SHORT_CMP_TYPE or LONG_CMP_TYPE          */
+/*         forceHdrSize32, non-zero to always use a 32-bit size field        */
+/*         budgetBytes, maximum size of header + compressed stream           */
+/*         prefixBytes, set to the number of input bytes that fit            */
+/*         pCmprBuf/cmprSizeBytes, set to the prefix's stream, laid out as   */
+/*                                 by cmp_encode (NULL if nothing fits)      */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int bud_fit(char* pData, size_t sizeBytes, int cmprType, int forceHdrSize32,
+			size_t budgetBytes, size_t* prefixBytes, char** pCmprBuf,
+			size_t* cmprSizeBytes)
+{
+	char* pScanBuf;
+	size_t unitSize, numUnits, scanUnits, scanBytes, scanCmprBytes;
+	size_t maxRunUnits, capUnits, prefixUnits;
+	int hdrBytes, rval;
+
+	*prefixBytes = 0;
+	*pCmprBuf = NULL;
+	*cmprSizeBytes = 0;
+	unitSize = cmp_unit_size(cmprType);
+	numUnits = (sizeBytes + unitSize - 1) / unitSize;
+
+	/* Runs cover the most input per stream byte, so nothing past */
+	/* budget/(2 units) maximum length runs can fit                */
+	switch(cmprType){
+		case SHORT_CMP_TYPE:
+			maxRunUnits = (size_t)MAX_S_SHORT + 2;
+			break;
+		case LONG_CMP_TYPE:
+			maxRunUnits = (size_t)MAX_S_LONG + 2;
+			break;
+		default:
+			maxRunUnits = (size_t)MAX_S_BYTE + 2;
+	}
+	scanUnits = numUnits;
+	if((budgetBytes / (2*unitSize)) < (numUnits / maxRunUnits))
+		scanUnits = (budgetBytes / (2*unitSize))*maxRunUnits + CMP_LOOKAHEAD_UNITS + 1;
+	if(scanUnits > numUnits)
+		scanUnits = numUnits;
+	scanBytes = (scanUnits == numUnits) ? sizeBytes : scanUnits*unitSize;
+
+	/* Single encode of everything that could possibly fit */
+	if(cmp_encode(pData,scanBytes,cmprType,&pScanBuf,&scanCmprBytes) < 0)
+		return -1;
+
+	/* Encode the best prefix, stepping back if the end of the input */
+	/* changed how its last tokens were formed                       */
+	rval = 0;
+	capUnits = numUnits + 1;
+	while(1){
+		if(bud_candidate(pScanBuf + CMP_MAX_HDR_BYTES,scanCmprBytes,cmprType,
+			forceHdrSize32,sizeBytes,scanUnits,(scanUnits == numUnits),
+			budgetBytes,capUnits,&prefixUnits) < 0){
+			printf("Error, compressed stream is truncated\n");
+			rval = -1;
+			break;
+		}
+		if(prefixUnits == 0)
+			break;
+		*prefixBytes = bud_prefixBytes(prefixUnits,unitSize,sizeBytes);
+
+		/* The scan already encoded exactly this input */
+		if(*prefixBytes == scanBytes){
+			*pCmprBuf = pScanBuf;
+			*cmprSizeBytes = scanCmprBytes;
+		}
+		else if(cmp_encode(pData,*prefixBytes,cmprType,pCmprBuf,cmprSizeBytes) < 0){
+			rval = -1;
+			break;
+		}
+		hdrBytes = bud_hdrBytes(*prefixBytes,cmprType,forceHdrSize32);
+		if((hdrBytes + *cmprSizeBytes) <= budgetBytes){
+			if(*pCmprBuf == pScanBuf)
+				pScanBuf = NULL;
+			break;
+		}
+		if(*pCmprBuf != pScanBuf)
+			free(*pCmprBuf);
+		*pCmprBuf = NULL;
+		*cmprSizeBytes = 0;
+		*prefixBytes = 0;
+		capUnits = prefixUnits;
+	}
+	free(pScanBuf);
+
+	/* 16/32-bit prefixes may also end part way through a unit */
+	if((rval == 0) && (bud_partialUnit(pData,sizeBytes,cmprType,forceHdrSize32,
+		budgetBytes,prefixBytes,pCmprBuf,cmprSizeBytes) < 0))
+		rval = -1;
+	if(rval < 0){
+		free(*pCmprBuf);
+		*pCmprBuf = NULL;
+		*cmprSizeBytes = 0;
+		*prefixBytes = 0;
+	}
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* bud_compress - Reports how much of an input fits a budget at each width,  */
+/*                then writes the longest fitting prefix at the selected     */
+/*                width.                                                     */
+/* Inputs: inputFname/outputFname, as for a full compress                    */
+/*         fileOffset/reqDataSizeBytes/cmprType/forceHdrSize32, as for a     */
+/*         full compress                                                     */
+/*         budgetBytes, maximum size of the output file                      */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int bud_compress(char* inputFname, char* outputFname, off_t fileOffset,
+				 size_t reqDataSizeBytes, int cmprType, int forceHdrSize32,
+				 size_t budgetBytes)
+{
+	cmpInput input;
+	char* pCmprBuf[3] = {NULL, NULL, NULL};
+	char* pOut;
+	size_t inputSizeBytes, prefixBytes[3], cmprSizeBytes[3];
+	int hdrBytes[3];
+	int best, sel, hdrSizeBytes, x, rval;
+
+	/* No prefix past the header's limit can be written, so don't read it */
+	if((reqDataSizeBytes == 0) || (reqDataSizeBytes > CMP_MAX_HDR_SIZE))
+		reqDataSizeBytes = (size_t)CMP_MAX_HDR_SIZE;
+	if(cmp_read_input(inputFname,fileOffset,reqDataSizeBytes,&input) < 0)
+		return -1;
+	inputSizeBytes = input.sizeBytes;
+
+	/* Every width, so the best one can be reported */
+	rval = 0;
+	best = -1;
+	sel = 0;
+	printf("Budget %lu bytes, input %lu bytes\n",(unsigned long)budgetBytes,
+		(unsigned long)inputSizeBytes);
+	printf("  %-8s %14s %8s %14s\n","width","prefix(bytes)","input%","output(bytes)");
+	for(x = 0; x < 3; x++){
+		if(bud_types[x] == cmprType)
+			sel = x;
+		if(bud_fit(input.pData,input.sizeBytes,bud_types[x],forceHdrSize32,
+			budgetBytes,&prefixBytes[x],&pCmprBuf[x],&cmprSizeBytes[x]) < 0){
+			rval = -1;
+			break;
+		}
+		hdrBytes[x] = (prefixBytes[x] > 0) ?
+			bud_hdrBytes(prefixBytes[x],bud_types[x],forceHdrSize32) : 0;
+		printf("  %-8s %14lu %8.1f %14lu\n",bud_typeNames[x],
+			(unsigned long)prefixBytes[x],
+			(inputSizeBytes > 0) ? 100.0*prefixBytes[x]/inputSizeBytes : 0.0,
+			(unsigned long)(hdrBytes[x] + cmprSizeBytes[x]));
+
+		/* Longest prefix wins, then the smaller output */
+		if((prefixBytes[x] > 0) && ((best < 0) ||
+			(prefixBytes[x] > prefixBytes[best]) ||
+			((prefixBytes[x] == prefixBytes[best]) &&
+			((hdrBytes[x] + cmprSizeBytes[x]) < (hdrBytes[best] + cmprSizeBytes[best])))))
+			best = x;
+	}
+	cmp_free_input(&input);
+
+	/* Emit the selected width */
+	if(rval == 0){
+		if(best >= 0)
+			printf("Best width: %s\n",bud_typeNames[best]);
+		if(prefixBytes[sel] == 0){
+			printf("Error, no %s data fits in %lu bytes\n",bud_typeNames[sel],
+				(unsigned long)budgetBytes);
+			rval = -1;
+		}
+		else{
+			pOut = cmp_prepend_header(pCmprBuf[sel],cmprType,prefixBytes[sel],
+				forceHdrSize32,&hdrSizeBytes);
+			if((pOut == NULL) ||
+				(cmp_write_output(outputFname,pOut,hdrSizeBytes + cmprSizeBytes[sel]) < 0))
+				rval = -1;
+			else
+				printf("Wrote %lu of %lu input bytes as %s\n",
+					(unsigned long)prefixBytes[sel],(unsigned long)inputSizeBytes,
+					bud_typeNames[sel]);
+		}
+	}
+	for(x = 0; x < 3; x++)
+		free(pCmprBuf[x]);
+
+	return rval;
+}
@@ -0,0 +1,18 @@
+/*****************************************************************************/
+/* budget.h - Fits the largest input prefix into a compressed size budget.   */
+/*****************************************************************************/
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//Fctn Prototypes
+int bud_fit(char* pData, size_t sizeBytes, int cmprType, int forceHdrSize32,
+			size_t budgetBytes, size_t* prefixBytes, char** pCmprBuf,
+			size_t* cmprSizeBytes);
+int bud_compress(char* inputFname, char* outputFname, off_t fileOffset,
+				 size_t reqDataSizeBytes, int cmprType, int forceHdrSize32,
+				 size_t budgetBytes);
+
+#endif
@@ -13,42 +13,102 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "compress_rtns.h"
+#include "profile.h"
+#include "server.h"
+#include "pipeline.h"
+#include "incremental.h"
+#include "budget.h"
+#include "watch.h"
 
 /* Defines */
 #define MIN_ARGS  5
-#define HDR_BYTE_CMP    0x0000
-#define HDR_WORD_CMP    0x0400
-#define HDR_LONG_CMP    0x0C00
-#define HDR_SIZE_4BYTE  0x0008
+#define MAX_FNAME_LEN   299   /* Sidecar and temp names add a short suffix */
 #define PROG_VERSION    "1.2"
 
+/* Globals */
+static int cmp_inServer = 0;   /* Running a job forwarded to the job server */
+
 /* Prototypes */
+int cmp_run(int argc, char** argv);
+int cmp_serverJob(int argc, char** argv);
+int cmpFile(char* inputFname, char* outputFname, off_t fileOffset,
+			size_t dataSizeBytes, int cmprType, int forceHdrSize32);
+int parseSize(char* str, unsigned long long* pVal);
+int loadBatchList(char* batchFname, char*** pInFnames, char*** pOutFnames);
+void freeBatchList(char** inFnames, char** outFnames, int numJobs);
 void printUsage();
 
 
 
 
 /*****************************************************************************/
-/* main - Checks input arguments, calls compression routine, puts header on  */
-/*        compressed data and outputs to a file.                             */
+/* main - Runs a single compression job, or starts the job server/client.    */
 /*****************************************************************************/
 int main(int argc, char** argv){
 
-	FILE* ofile;
-	char* pCmprData, *pHdr;
-	unsigned short* pUshortHdr;
-	char hdr[8];
-	static char inputFname[300];
-	static char outputFname[300];
-	int cmprTypeErr, cmprType, forceHdrSize32, hdrSizeBytes, x, rval;
-	int fileOffset, dataSizeBytes, cmprSizeBytes, decmprSizeBytes;
+	char* sockPath;
+
+	/* Persistent job server, runs until a client sends --shutdown */
+	if((argc == 3) && (strcmp(argv[1],"--server") == 0))
+		return srv_serve(argv[2], cmp_serverJob);
+
+	/* Thin client, forwards the remaining arguments to the server */
+	if((argc >= 3) && (strcmp(argv[1],"--client") == 0)){
+		sockPath = argv[2];
+		argv[2] = argv[0];
+		return srv_client(sockPath, argc-2, argv+2, cmp_run);
+	}
+
+	return cmp_run(argc, argv);
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_serverJob - Runs a job forwarded to the job server.                   */
+/*                 Returns: the job's return value.                          */
+/*****************************************************************************/
+int cmp_serverJob(int argc, char** argv){
+
+	int rval;
+
+	cmp_inServer = 1;
+	rval = cmp_run(argc, argv);
+	cmp_inServer = 0;
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_run - Checks input arguments, calls compression routine, puts header  */
+/*           on compressed data and outputs to a file.                       */
+/*           Returns: 0 on success, -1 on failure.                           */
+/*****************************************************************************/
+int cmp_run(int argc, char** argv){
+
+	char* inputFname, *outputFname;
+	char* batchFname;
+	char** inFnames, **outFnames;
+	int cmprTypeErr, cmprType, forceHdrSize32, x, rval;
+	int profile, incremental, watch, numJobs, queueDepth;
+	unsigned long long argVal;
+	off_t fileOffset;
+	size_t dataSizeBytes, budgetBytes;
 
 	/* Init */
-	cmprTypeErr = cmprType = forceHdrSize32 = hdrSizeBytes = 0;
-	fileOffset = dataSizeBytes = 0;
-	cmprSizeBytes = decmprSizeBytes = 0;
-	pCmprData = NULL;
+	cmprTypeErr = cmprType = forceHdrSize32 = 0;
+	profile = incremental = watch = numJobs = 0;
+	fileOffset = 0;
+	dataSizeBytes = budgetBytes = 0;
+	queueDepth = PIPE_DEFAULT_DEPTH;
+	batchFname = inputFname = outputFname = NULL;
+	inFnames = outFnames = NULL;
 
 	printf("cmp_cmpress v%s\n",PROG_VERSION);
 
@@ -111,7 +171,11 @@ int main(int argc, char** argv){
 		if(strcmp(argv[x],"-f") == 0){
 			if(argc > (x+1)){
 				x++;
-				fileOffset = atoi(argv[x]);
+				if(parseSize(argv[x],&argVal) < 0){
+					printf("Error in file offset.\n");
+					return -1;
+				}
+				fileOffset = (off_t)argVal;
 			}
 		}
 
@@ -119,12 +183,11 @@ int main(int argc, char** argv){
 		else if(strcmp(argv[x],"-s") == 0){
 			if(argc > (x+1)){
 				x++;
-				dataSizeBytes = atoi(argv[x]);
-				/* Saturn CD is only going to have at most 700MB */
-				if(dataSizeBytes > (700*1024*1024)){
-					printf("Error, data size > 700MB\n");
+				if((parseSize(argv[x],&argVal) < 0) || (argVal > CMP_MAX_HDR_SIZE)){
+					printf("Error in data size.\n");
 					return -1;
 				}
+				dataSizeBytes = (size_t)argVal;
 			}
 		}
 
@@ -136,6 +199,54 @@ int main(int argc, char** argv){
 			forceHdrSize32 = 1;
 		}
 
+		/* Batch list of input/output filenames */
+		else if(strcmp(argv[x],"-b") == 0){
+			if(argc > (x+1)){
+				x++;
+				batchFname = argv[x];
+			}
+		}
+
+		/* Pipeline queue depth for batches */
+		else if(strcmp(argv[x],"-q") == 0){
+			if(argc > (x+1)){
+				x++;
+				queueDepth = atoi(argv[x]);
+				if(queueDepth < 1){
+					printf("Error, queue depth must be at least 1\n");
+					return -1;
+				}
+			}
+		}
+
+		/* Re-encode only what changed since the last run */
+		else if(strcmp(argv[x],"-i") == 0){
+			incremental = 1;
+		}
+
+		/* Fit the longest prefix into a compressed size budget */
+		else if(strcmp(argv[x],"--budget") == 0){
+			if(argc > (x+1)){
+				x++;
+				if((parseSize(argv[x],&argVal) < 0) || (argVal == 0) ||
+					(argVal > CMP_MAX_INPUT_BYTES)){
+					printf("Error in budget size.\n");
+					return -1;
+				}
+				budgetBytes = (size_t)argVal;
+			}
+		}
+
+		/* Keep an output tree up to date with a source tree */
+		else if(strcmp(argv[x],"--watch") == 0){
+			watch = 1;
+		}
+
+		/* Report per-phase timing and hardware counters */
+		else if(strcmp(argv[x],"--profile") == 0){
+			profile = 1;
+		}
+
 		/* End of optional arguments */
 		else
 			break;
@@ -145,109 +256,286 @@ int main(int argc, char** argv){
 	/********************************/
 	/* Parse Input/Output Filenames */
 	/********************************/
-	if( (argc - x) != 2){
+	if((budgetBytes > 0) && ((batchFname != NULL) || incremental)){
+		printf("Error, --budget cannot be combined with -b or -i\n");
+		return -1;
+	}
+	if(watch && ((batchFname != NULL) || incremental || (budgetBytes > 0))){
+		printf("Error, --watch cannot be combined with -b, -i or --budget\n");
+		return -1;
+	}
+	if(watch && cmp_inServer){
+		printf("Error, --watch does not return, so it cannot run in the job server\n");
+		return -1;
+	}
+	if(profile && (incremental || (budgetBytes > 0) || watch)){
+		printf("Error, --profile cannot be combined with -i, --budget or --watch\n");
+		return -1;
+	}
+	if(batchFname != NULL){
+		if(argc != x){
+			printf("Error in input arguments\n");
+			printUsage();
+			return -1;
+		}
+	}
+	else if( (argc - x) != 2){
         printf("Error in input arguments\n");
 		printUsage();
 		return -1;
 	}
+	else if((strlen(argv[x]) > MAX_FNAME_LEN) || (strlen(argv[x+1]) > MAX_FNAME_LEN)){
+		printf("Error, filenames are limited to %d characters\n",MAX_FNAME_LEN);
+		return -1;
+	}
 	else{
-		strcpy(inputFname,  argv[x++]);
-		strcpy(outputFname, argv[x]);
+		inputFname  = argv[x++];
+		outputFname = argv[x];
 	}
 
 
 	/***************************/
 	/* Perform the Compression */
 	/***************************/
+	if(profile)
+		prof_init();
+
+	if(watch){
+		rval = watch_run(inputFname, outputFname, fileOffset, dataSizeBytes,
+			cmprType, forceHdrSize32);
+	}
+	else if(budgetBytes > 0){
+		rval = bud_compress(inputFname, outputFname, fileOffset, dataSizeBytes,
+			cmprType, forceHdrSize32, budgetBytes);
+	}
+	else if((batchFname == NULL) && incremental){
+		rval = incr_compress(inputFname, outputFname, fileOffset, dataSizeBytes,
+			cmprType, forceHdrSize32);
+	}
+	else if(batchFname == NULL){
+		rval = cmpFile(inputFname, outputFname, fileOffset, dataSizeBytes,
+			cmprType, forceHdrSize32);
+	}
+	else{
+		numJobs = loadBatchList(batchFname, &inFnames, &outFnames);
+		if(numJobs < 0)
+			rval = -1;
+
+		/* Incremental batches update one output at a time */
+		else if(incremental){
+			rval = 0;
+			for(x = 0; x < numJobs; x++){
+				if(incr_compress(inFnames[x], outFnames[x], fileOffset,
+					dataSizeBytes, cmprType, forceHdrSize32) < 0)
+					rval = -1;
+			}
+		}
+
+		/* Profiled batches run one file at a time so that counters */
+		/* are attributed to a single phase of a single file        */
+		else if(profile){
+			rval = 0;
+			for(x = 0; x < numJobs; x++){
+				if(cmpFile(inFnames[x], outFnames[x], fileOffset, dataSizeBytes,
+					cmprType, forceHdrSize32) < 0)
+					rval = -1;
+			}
+		}
+		else{
+			rval = pipe_run(inFnames, outFnames, numJobs, fileOffset,
+				dataSizeBytes, cmprType, forceHdrSize32, queueDepth);
+		}
+		freeBatchList(inFnames, outFnames, numJobs);
+	}
+
+	/* Report profiling results */
+	if(profile){
+		prof_report_aggregate();
+		prof_shutdown();
+	}
+
+	if(rval < 0)
+		return -1;
+
+	/* Success */
+	printf("Compression Completed Sucessfully!\n");
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmpFile - Compresses a single file, puts the header on the compressed     */
+/*           data and writes it out.                                         */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int cmpFile(char* inputFname, char* outputFname, off_t fileOffset,
+			size_t dataSizeBytes, int cmprType, int forceHdrSize32){
+
+	char* pCmprBuf, *pOut;
+	int hdrSizeBytes, rval;
+	size_t cmprSizeBytes, decmprSizeBytes;
+
+	/* Init */
+	pCmprBuf = NULL;
+	cmprSizeBytes = decmprSizeBytes = 0;
+
+	/* Compress */
     rval = cmp_compress(inputFname, fileOffset, dataSizeBytes, 
-		cmprType, &cmprSizeBytes, &decmprSizeBytes, &pCmprData);
+		cmprType, &cmprSizeBytes, &decmprSizeBytes, &pCmprBuf);
 	if(rval < 0){
 		printf("Error encountered during compression.\n");
 		return -1;
 	}
 
+	/* Construct the Compression Header in front of the compressed data */
+	prof_begin(PROF_PHASE_HEADER);
+	pOut = cmp_prepend_header(pCmprBuf, cmprType, decmprSizeBytes,
+		forceHdrSize32, &hdrSizeBytes);
+	prof_end(PROF_PHASE_HEADER);
+	if(pOut == NULL){
+		free(pCmprBuf);
+		return -1;
+	}
 
+	/* Write the header and compressed data to the output file */
+	prof_begin(PROF_PHASE_WRITE);
+	rval = cmp_write_output(outputFname, pOut, hdrSizeBytes + cmprSizeBytes);
+	free(pCmprBuf);
+	prof_end(PROF_PHASE_WRITE);
 
-	/************************************/
-	/* Construct the Compression Header */
-	/************************************/
-
-	///////////////////////////////////////////////////////////////////////////
-	// Header Format - Variable Length (32-bits or 64-bits)
-	// Word 0 [16-bits]
-    //   Compression Type
-	//   Value:  0000_YY00 0000_Z000
-    //           where: YY = 00 (8-bit RLE), 01 (16-bit RLE), 10 (32-bit RLE)
-	//                  Z determines format of the rest of the header
-	//
-    // If Z = 0:
-	// Word 1 [16-bits]
-	//   Decompression Size in Bytes.
-	// End of Header
-	//
-	// If Z = 1:
-	// Word 1 [16-bits]
-	//   16-bit padding.  Required for alignment of the 32-bit size to follow
-	// Words 2,3 [Combine for 32-bit LW]
-	//   Decompression Size in Bytes.
-	// End of Header
-    ///////////////////////////////////////////////////////////////////////////
-	pHdr = hdr;
-	pUshortHdr = (unsigned short*)hdr;
-	memset(pHdr,0,8);  /* Zero the header */
-
-	/* Fill in the compression type */
-	switch(cmprType){
-		case BYTE_CMP_TYPE:
-			*pUshortHdr = HDR_BYTE_CMP;
-			break;
-		case SHORT_CMP_TYPE:
-			*pUshortHdr = HDR_WORD_CMP;
-			break;
-		case LONG_CMP_TYPE:
-			*pUshortHdr = HDR_LONG_CMP;
-			break;
-	}
+	prof_file_done(inputFname, decmprSizeBytes);
 
-	/* Set flag indictating that 2 or 4 bytes are set */
-	/* Aside in the header for the decompressed size  */
-	/* If 4 bytes, then 2 bytes of padding exist between the */
-	/* header and size information */
-	/* Also copy in the size information */
-	if(forceHdrSize32 || (decmprSizeBytes > 65535)){
-		*pUshortHdr |= HDR_SIZE_4BYTE;
-		swap16(pUshortHdr);
-		swap32(&decmprSizeBytes);
-		memcpy(pHdr+4,&decmprSizeBytes,4);
-		hdrSizeBytes = 8;
-	}
-	else{
-		unsigned short shrt_decmprSize = (unsigned short)decmprSizeBytes;
-		swap16(pUshortHdr);
-		swap16(&shrt_decmprSize);
-		memcpy(pHdr+2,&shrt_decmprSize,2);
-		hdrSizeBytes = 4;
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* parseSize - Parses a non-negative decimal (or 0x hex) size or offset.     */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int parseSize(char* str, unsigned long long* pVal){
+
+	char* pEnd;
+
+	if((str[0] == '\0') || (str[0] == '-'))
+		return -1;
+	errno = 0;
+	*pVal = strtoull(str,&pEnd,0);
+	if((errno != 0) || (*pEnd != '\0'))
+		return -1;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* loadBatchList - Reads a batch list file.  Each non-blank line holds an    */
+/*                 input filename and an output filename separated by        */
+/*                 whitespace.  Lines starting with '#' are ignored.         */
+/* Returns: number of jobs on success, -1 on failure.                        */
+/*****************************************************************************/
+int loadBatchList(char* batchFname, char*** pInFnames, char*** pOutFnames){
+
+	FILE* bfile;
+	static char line[1024];
+	char inName[300], outName[300];
+	char** inFnames = NULL;
+	char** outFnames = NULL;
+	int numJobs = 0;
+	int maxJobs = 0;
+	int lineNum = 0;
+
+	bfile = fopen(batchFname,"r");
+	if(bfile == NULL){
+		printf("Error opening batch list %s\n",batchFname);
+		return -1;
 	}
 
+	while(fgets(line,sizeof(line),bfile) != NULL){
+		int numFields;
+		lineNum++;
+		if(line[0] == '#')
+			continue;
+		numFields = sscanf(line,"%299s %299s",inName,outName);
+		if(numFields <= 0)
+			continue;
+		if(numFields != 2){
+			printf("Error in batch list line %d\n",lineNum);
+			freeBatchList(inFnames,outFnames,numJobs);
+			fclose(bfile);
+			return -1;
+		}
 
-	/***********************************************************/
-	/* Write the header and compressed data to the output file */
-	/***********************************************************/
-	ofile = NULL;
-	ofile = fopen(outputFname,"wb");
-	if(ofile == NULL){
-		printf("Error opening output file for writing.\n");
+		/* Grow the job arrays as needed */
+		if(numJobs == maxJobs){
+			char** tmpIn, **tmpOut;
+			maxJobs = (maxJobs == 0) ? 64 : maxJobs*2;
+			tmpIn  = (char**)realloc(inFnames,maxJobs*sizeof(char*));
+			if(tmpIn != NULL)
+				inFnames = tmpIn;
+			tmpOut = (char**)realloc(outFnames,maxJobs*sizeof(char*));
+			if(tmpOut != NULL)
+				outFnames = tmpOut;
+			if((tmpIn == NULL) || (tmpOut == NULL)){
+				printf("Error allocating memory for batch list\n");
+				freeBatchList(inFnames,outFnames,numJobs);
+				fclose(bfile);
+				return -1;
+			}
+		}
+		inFnames[numJobs]  = (char*)malloc(strlen(inName)+1);
+		outFnames[numJobs] = (char*)malloc(strlen(outName)+1);
+		if((inFnames[numJobs] == NULL) || (outFnames[numJobs] == NULL)){
+			printf("Error allocating memory for batch list\n");
+			numJobs++;
+			freeBatchList(inFnames,outFnames,numJobs);
+			fclose(bfile);
+			return -1;
+		}
+		strcpy(inFnames[numJobs],inName);
+		strcpy(outFnames[numJobs],outName);
+		numJobs++;
+	}
+	fclose(bfile);
+
+	if(numJobs == 0){
+		printf("Error, batch list %s is empty\n",batchFname);
+		freeBatchList(inFnames,outFnames,numJobs);
 		return -1;
 	}
-	fwrite(pHdr,1,hdrSizeBytes,ofile);
-	fwrite(pCmprData,1,cmprSizeBytes,ofile);
-	fclose(ofile);
 
+	*pInFnames = inFnames;
+	*pOutFnames = outFnames;
 
-	/* Success */
-	printf("Compression Completed Sucessfully!\n");
+	return numJobs;
+}
 
-	return 0;
+
+
+
+/*****************************************************************************/
+/* freeBatchList - Frees the job arrays allocated by loadBatchList.          */
+/*****************************************************************************/
+void freeBatchList(char** inFnames, char** outFnames, int numJobs){
+
+	int x;
+	for(x = 0; x < numJobs; x++){
+		if(inFnames != NULL)
+			free(inFnames[x]);
+		if(outFnames != NULL)
+			free(outFnames[x]);
+	}
+	free(inFnames);
+	free(outFnames);
+
+	return;
 }
 
 
@@ -259,11 +547,30 @@ int main(int argc, char** argv){
 void printUsage(){
 
 	printf("cmp_cmpress -t cmprType [options] inputFile outputFile\n");
+	printf("cmp_cmpress -t cmprType [options] -b batchList\n");
+	printf("cmp_cmpress -t cmprType [options] --watch sourceDir outputDir\n");
+	printf("cmp_cmpress --server socketPath\n");
+	printf("cmp_cmpress --client socketPath -t cmprType [options] inputFile outputFile\n");
+	printf("cmp_cmpress --client socketPath --shutdown\n");
 	printf("  where cmprType is: 8, 16, or 32\n");
 	printf("    Available options:\n");
+	printf("      -b list   Batch list, one 'inputFile outputFile' pair per line\n");
 	printf("      -f offset Byte offset in input file to begin compression\n");
 	printf("      -h        Help, Prints this message\n");
+	printf("      -i        Incremental, re-encode only changed input using\n");
+	printf("                the outputFile%s index from the last run\n",INCR_SIDECAR_EXT);
+	printf("      -q depth  Batch pipeline queue depth (default %d).  Only -b\n",PIPE_DEFAULT_DEPTH);
+	printf("                batches overlap reading, compressing and writing,\n");
+	printf("                a single inputFile runs each step in turn\n");
 	printf("      -s size   Maximum number of bytes to compress\n");
-	printf("      -w        Force 32-bit size in header\n\n");
+	printf("      -w        Force 32-bit size in header\n");
+	printf("      --budget n Write the longest prefix whose output fits in n\n");
+	printf("                bytes, reporting the fit at each width\n");
+	printf("      --profile Report per-phase timing and hardware counters\n");
+	printf("                (not with -i, --budget or --watch)\n");
+	printf("      --watch   Recompress files under sourceDir into outputDir\n");
+	printf("                (adding %s) as they change, until Ctrl-C\n",WATCH_OUT_EXT);
+	printf("  --server runs a job server on a local socket, --client forwards\n");
+	printf("  the job to it (or runs locally if the server is unavailable)\n\n");
 	return;
 }
@@ -0,0 +1,659 @@
+/*****************************************************************************/
+/* cmpr_fuzz.c - Differential fuzzing of the CMP encoders.                   */
+/*               Every encoder path is compared against the frozen reference */
+/*               routines in cmpr_ref.c and must produce byte-identical      */
+/*               output.  Incremental splicing (incremental.c) is checked by */
+/*               editing each input, applying the edits to a file and        */
+/*               comparing it with a reference encode of the edited input,   */
+/*               and budget mode (budget.c) by fitting a prefix of each      */
+/*               input to a budget.                                          */
+/*                                                                           */
+/*   Built with -DCMP_LIBFUZZER this provides LLVMFuzzerTestOneInput, where  */
+/*   the first byte of each input selects 8/16/32-bit compression and the    */
+/*   rest is the data to compress.  Otherwise it builds a standalone driver: */
+/*     cmpr_fuzz [iterations] [seed]   Random corpus of edge cases           */
+/*     cmpr_fuzz -r file ...           Replay inputs in libFuzzer format     */
+/*****************************************************************************/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress_rtns.h"
+#include "cmpr_ref.h"
+#include "incremental.h"
+#include "budget.h"
+
+/* Defines */
+#define FUZZ_MAX_INPUT_BYTES  (512*1024)
+#define FUZZ_DEFAULT_ITERS    2000
+#define FUZZ_DEFAULT_SEED     1
+#define FUZZ_FAIL_FNAME       "cmpr_fuzz_fail.bin"
+#define FUZZ_SPLICE_FNAME     "cmpr_fuzz_splice.tmp"
+#define FUZZ_MAX_RANDOM_RUN   4096   /* 32-bit limits are far too large */
+#define FUZZ_MAX_EDITS        4
+#define FUZZ_MAX_EDIT_UNITS   300
+
+/* Prototypes */
+int fuzz_check(const unsigned char* data, size_t sizeBytes, int cmprType);
+
+
+
+
+/*****************************************************************************/
+/* fuzz_refEncode - Compresses with the frozen reference routines.           */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int fuzz_refEncode(char* pData, size_t sizeBytes, int cmprType,
+						  char** pOut, int* outSizeBytes)
+{
+	int unitSizeBytes = (int)cmp_unit_size(cmprType);
+	int numUnits = (int)((sizeBytes + unitSizeBytes - 1) / unitSizeBytes);
+
+	*pOut = NULL;
+	switch(cmprType){
+		case BYTE_CMP_TYPE:
+			return ref_cmpr_8bit(pData,numUnits,pOut,outSizeBytes);
+		case SHORT_CMP_TYPE:
+			return ref_cmpr_16bit((short*)pData,numUnits,
+				(short**)pOut,outSizeBytes);
+		case LONG_CMP_TYPE:
+			return ref_cmpr_32bit((int*)pData,numUnits,
+				(int**)pOut,outSizeBytes);
+	}
+
+	return -1;
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_editRand - xorshift64* step for the edit generator.                  */
+/*****************************************************************************/
+static size_t fuzz_editRand(unsigned long long* pState){
+
+	*pState ^= *pState >> 12;
+	*pState ^= *pState << 25;
+	*pState ^= *pState >> 27;
+
+	return (size_t)((*pState * 2685821657736338717ULL) >> 33);
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_applyEdits - Writes a stream behind a dummy header, applies the      */
+/*                   edits to the file with incr_apply_edits and compares    */
+/*                   the result with the reference stream.                   */
+/* Returns: 0 if the edited file matches, -1 on a mismatch.                  */
+/*****************************************************************************/
+static int fuzz_applyEdits(char* pCmprData, size_t cmprSizeBytes, int cmprType,
+						   incrEdit* edits, size_t numEdits, char* pRef,
+						   size_t refSizeBytes, size_t hdrSizeBytes)
+{
+	char* pFile;
+	size_t newCmprSizeBytes, x;
+	FILE* ofile;
+	int rval = 0;
+
+	pFile = (char*)malloc(hdrSizeBytes + (cmprSizeBytes > refSizeBytes ?
+		cmprSizeBytes : refSizeBytes) + 1);
+	if(pFile == NULL)
+		return 0;
+	memset(pFile,0xA5,hdrSizeBytes);
+	memcpy(pFile + hdrSizeBytes,pCmprData,cmprSizeBytes);
+	if(cmp_write_output(FUZZ_SPLICE_FNAME,pFile,hdrSizeBytes + cmprSizeBytes) < 0){
+		free(pFile);
+		return 0;
+	}
+
+	newCmprSizeBytes = cmprSizeBytes;
+	for(x = 0; x < numEdits; x++)
+		newCmprSizeBytes += edits[x].newSizeBytes - (edits[x].oldEnd - edits[x].oldStart);
+	if(incr_apply_edits(FUZZ_SPLICE_FNAME,hdrSizeBytes,cmprSizeBytes,
+		newCmprSizeBytes,edits,numEdits) < 0){
+		printf("Mismatch: incr_apply_edits failed, type %d\n",cmprType);
+		rval = -1;
+	}
+
+	/* Header must be untouched and the stream match the reference */
+	else if((ofile = fopen(FUZZ_SPLICE_FNAME,"rb")) != NULL){
+		memset(pFile,0,hdrSizeBytes);
+		if((fread(pFile,1,hdrSizeBytes + refSizeBytes + 1,ofile) !=
+			(hdrSizeBytes + refSizeBytes)) ||
+			(memcmp(pFile + hdrSizeBytes,pRef,refSizeBytes) != 0)){
+			printf("Mismatch: spliced stream differs, type %d, %lu edits\n",
+				cmprType,(unsigned long)numEdits);
+			rval = -1;
+		}
+		for(x = 0; (rval == 0) && (x < hdrSizeBytes); x++){
+			if((unsigned char)pFile[x] != 0xA5){
+				printf("Mismatch: header overwritten by splice, type %d\n",cmprType);
+				rval = -1;
+			}
+		}
+		fclose(ofile);
+	}
+	remove(FUZZ_SPLICE_FNAME);
+	free(pFile);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_checkSplice - Edits an input, splices the re-encoded tokens into its */
+/*                    stream and compares with a reference encode.  The      */
+/*                    edits are derived from the input itself so libFuzzer   */
+/*                    runs are reproducible.                                 */
+/* Returns: 0 if the spliced stream matches, -1 on a mismatch.               */
+/*****************************************************************************/
+static int fuzz_checkSplice(char* pData, size_t sizeBytes, int cmprType,
+							char* pCmprData, size_t cmprSizeBytes)
+{
+	char* pNew, *pRef;
+	incrPoint* oldPoints, *newPoints;
+	incrRange ranges[FUZZ_MAX_EDITS];
+	incrEdit* edits;
+	unsigned long long state;
+	size_t unitSize, numUnits, numOldPoints, numNewPoints, numEdits;
+	size_t reencodedUnits, start, len, x, y;
+	int numRanges, refSizeBytes, rval;
+
+	unitSize = cmp_unit_size(cmprType);
+	numUnits = (sizeBytes + unitSize - 1) / unitSize;
+
+	/* Edit generator seeded from the input */
+	state = 0xCBF29CE484222325ULL;
+	for(x = 0; x < sizeBytes; x++)
+		state = (state ^ (unsigned char)pData[x]) * 0x100000001B3ULL;
+	if(state == 0)
+		state = 1;
+	if(incr_build_index(pCmprData,cmprSizeBytes,cmprType,1 + fuzz_editRand(&state) % 64,
+		&oldPoints,&numOldPoints) < 0){
+		printf("Mismatch: incr_build_index failed, type %d, %lu bytes\n",
+			cmprType,(unsigned long)sizeBytes);
+		return -1;
+	}
+
+	/* Sorted, disjoint edits: constant fills, noise or copies of a neighbor */
+	pNew = (char*)malloc(numUnits*unitSize + CMP_UNIT_PAD_BYTES);
+	if(pNew == NULL){
+		free(oldPoints);
+		return 0;
+	}
+	memcpy(pNew,pData,sizeBytes);
+	numRanges = 0;
+	start = 0;
+	for(x = 1 + fuzz_editRand(&state) % FUZZ_MAX_EDITS; (x > 0) && (start < numUnits); x--){
+		start += fuzz_editRand(&state) % (1 + (numUnits - start) / 2);
+		len = 1 + fuzz_editRand(&state) % FUZZ_MAX_EDIT_UNITS;
+		if(len > (numUnits - start))
+			len = numUnits - start;
+		switch(fuzz_editRand(&state) % 3){
+			case 0:
+				memset(pNew + start*unitSize,(int)(fuzz_editRand(&state) % 3),len*unitSize);
+				break;
+			case 1:
+				for(y = 0; y < len*unitSize; y++)
+					pNew[start*unitSize + y] = (char)fuzz_editRand(&state);
+				break;
+			default:
+				for(y = 0; (y < len) && (start > 0); y++)
+					memcpy(pNew + (start + y)*unitSize,pNew + (start - 1)*unitSize,unitSize);
+		}
+		ranges[numRanges].startUnit = start;
+		ranges[numRanges].endUnit = start + len;
+		numRanges++;
+		start += len;
+	}
+
+	/* Padding past the input stays zero */
+	memset(pNew + sizeBytes,0,numUnits*unitSize + CMP_UNIT_PAD_BYTES - sizeBytes);
+
+	rval = 0;
+	if(incr_splice(pNew,sizeBytes,cmprType,cmprSizeBytes,oldPoints,numOldPoints,
+		ranges,numRanges,1 + fuzz_editRand(&state) % 64,4 + fuzz_editRand(&state) % 64,
+		&edits,&numEdits,&newPoints,&numNewPoints,&reencodedUnits) < 0){
+		printf("Mismatch: incr_splice failed, type %d, %lu bytes\n",
+			cmprType,(unsigned long)sizeBytes);
+		free(oldPoints);
+		free(pNew);
+		return -1;
+	}
+
+	/* Apply the edits and compare with the reference */
+	if(fuzz_refEncode(pNew,sizeBytes,cmprType,&pRef,&refSizeBytes) < 0){
+		printf("Mismatch: reference failed on edited input, type %d\n",cmprType);
+		rval = -1;
+	}
+	if(rval == 0)
+		rval = fuzz_applyEdits(pCmprData,cmprSizeBytes,cmprType,edits,numEdits,
+			pRef,(size_t)refSizeBytes,4 + 4*(fuzz_editRand(&state) % 2));
+	if(rval == 0){
+		/* New index must match a fresh index of the reference stream */
+		for(x = 0; (rval == 0) && (x < numNewPoints); x++){
+			size_t tokUnits, tokBytes, unitPos = 0, outPos = 0;
+			int resync = 1;
+			while((outPos < newPoints[x].outOffset) &&
+				(incr_parse_token(pRef + outPos,refSizeBytes - outPos,cmprType,
+				&tokUnits,&tokBytes,&resync) == 0)){
+				outPos += tokBytes;
+				unitPos += tokUnits;
+			}
+			if((outPos != newPoints[x].outOffset) || (unitPos != newPoints[x].unitOffset) ||
+				!resync){
+				printf("Mismatch: bad index point %lu, type %d, %lu bytes\n",
+					(unsigned long)x,cmprType,(unsigned long)sizeBytes);
+				rval = -1;
+			}
+		}
+	}
+	free(pRef);
+	incr_free_edits(edits,numEdits);
+	free(newPoints);
+	free(oldPoints);
+	free(pNew);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_checkBudget - Fits a prefix of an input to a budget and compares the */
+/*                    stream with a reference encode of that prefix.  A      */
+/*                    prefix one byte longer must not fit.                   */
+/* Returns: 0 if the prefix stream matches and fits, -1 otherwise.           */
+/*****************************************************************************/
+static int fuzz_checkBudget(char* pData, size_t sizeBytes, int cmprType,
+							size_t budgetBytes)
+{
+	char hdr[CMP_MAX_HDR_BYTES];
+	char* pCmprBuf, *pRef, *pPrefix;
+	size_t prefixBytes, cmprSizeBytes;
+	int refSizeBytes, hdrSizeBytes, rval;
+
+	if(bud_fit(pData,sizeBytes,cmprType,0,budgetBytes,&prefixBytes,
+		&pCmprBuf,&cmprSizeBytes) < 0){
+		printf("Mismatch: bud_fit failed, type %d, %lu bytes\n",
+			cmprType,(unsigned long)sizeBytes);
+		return -1;
+	}
+
+	/* Reference encode of the prefix, zero padded as a -s run would be */
+	rval = 0;
+	pPrefix = (char*)calloc(prefixBytes + 1 + CMP_UNIT_PAD_BYTES,1);
+	if(pPrefix == NULL){
+		free(pCmprBuf);
+		return 0;
+	}
+	if(prefixBytes > 0){
+		memcpy(pPrefix,pData,prefixBytes);
+		hdrSizeBytes = cmp_build_header(cmprType,prefixBytes,0,hdr);
+		if(fuzz_refEncode(pPrefix,prefixBytes,cmprType,&pRef,&refSizeBytes) < 0)
+			rval = -1;
+		else if((cmprSizeBytes != (size_t)refSizeBytes) ||
+			(memcmp(pCmprBuf + CMP_MAX_HDR_BYTES,pRef,cmprSizeBytes) != 0) ||
+			((hdrSizeBytes + cmprSizeBytes) > budgetBytes))
+			rval = -1;
+		free(pRef);
+		if(rval < 0)
+			printf("Mismatch: budget %lu prefix %lu differs, type %d, %lu bytes\n",
+				(unsigned long)budgetBytes,(unsigned long)prefixBytes,cmprType,
+				(unsigned long)sizeBytes);
+	}
+
+	/* One more byte must not fit */
+	if((rval == 0) && (prefixBytes < sizeBytes)){
+		pPrefix[prefixBytes] = pData[prefixBytes];
+		hdrSizeBytes = cmp_build_header(cmprType,prefixBytes + 1,0,hdr);
+		if((fuzz_refEncode(pPrefix,prefixBytes + 1,cmprType,&pRef,&refSizeBytes) == 0) &&
+			((hdrSizeBytes + refSizeBytes) <= (int)budgetBytes)){
+			printf("Mismatch: budget %lu prefix %lu is not the longest, type %d, "
+				"%lu bytes\n",(unsigned long)budgetBytes,(unsigned long)prefixBytes,
+				cmprType,(unsigned long)sizeBytes);
+			rval = -1;
+		}
+		free(pRef);
+	}
+	free(pPrefix);
+	free(pCmprBuf);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_check - Compresses an input with every encoder path and compares the */
+/*              result against the reference routines.                       */
+/* Returns: 0 if all paths match, -1 on a mismatch.                          */
+/*****************************************************************************/
+int fuzz_check(const unsigned char* data, size_t sizeBytes, int cmprType){
+
+	char* pData, *pRef, *pCmprBuf;
+	int refSizeBytes, refRval, rval;
+	size_t cmprSizeBytes, x;
+
+	if((sizeBytes == 0) || (sizeBytes > FUZZ_MAX_INPUT_BYTES))
+		return 0;
+
+	/* Zero pad to a whole unit, as cmp_read_input does */
+	pData = (char*)calloc(sizeBytes + CMP_UNIT_PAD_BYTES,1);
+	if(pData == NULL)
+		return 0;
+	memcpy(pData,data,sizeBytes);
+
+	refRval = fuzz_refEncode(pData,sizeBytes,cmprType,&pRef,&refSizeBytes);
+	rval = 0;
+
+	/* Top level encoder path */
+	if(cmp_encode(pData,sizeBytes,cmprType,&pCmprBuf,&cmprSizeBytes) < 0){
+		if(refRval == 0){
+			printf("Mismatch: cmp_encode failed, type %d, %lu bytes\n",
+				cmprType,(unsigned long)sizeBytes);
+			rval = -1;
+		}
+	}
+	else{
+		char* pCmprData = pCmprBuf + CMP_MAX_HDR_BYTES;
+		if(refRval < 0){
+			printf("Mismatch: reference failed, type %d, %lu bytes\n",
+				cmprType,(unsigned long)sizeBytes);
+			rval = -1;
+		}
+		else if(cmprSizeBytes != (size_t)refSizeBytes){
+			printf("Mismatch: cmp_encode size %lu, reference %d, type %d, %lu bytes\n",
+				(unsigned long)cmprSizeBytes,refSizeBytes,cmprType,
+				(unsigned long)sizeBytes);
+			rval = -1;
+		}
+		else if(memcmp(pCmprData,pRef,cmprSizeBytes) != 0){
+			for(x = 0; pCmprData[x] == pRef[x]; x++);
+			printf("Mismatch: cmp_encode differs at byte %lu, type %d, %lu bytes\n",
+				(unsigned long)x,cmprType,(unsigned long)sizeBytes);
+			rval = -1;
+		}
+		else if(fuzz_checkSplice(pData,sizeBytes,cmprType,pCmprData,cmprSizeBytes) < 0)
+			rval = -1;
+		else{
+			/* Budgets from nothing fitting up to everything fitting */
+			for(x = 1; (x <= 4) && (rval == 0); x++)
+				rval = fuzz_checkBudget(pData,sizeBytes,cmprType,
+					x*(cmprSizeBytes + CMP_MAX_HDR_BYTES)/4 + sizeBytes % 7);
+		}
+		free(pCmprBuf);
+	}
+
+	free(pRef);
+	free(pData);
+
+	return rval;
+}
+
+
+
+
+#ifdef CMP_LIBFUZZER
+/*****************************************************************************/
+/* LLVMFuzzerTestOneInput - libFuzzer entry point.                           */
+/*****************************************************************************/
+int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size){
+
+	if(size < 2)
+		return 0;
+	if(fuzz_check(data+1,size-1,data[0] % 3) < 0)
+		abort();
+
+	return 0;
+}
+
+
+#else
+
+
+/* Globals */
+static unsigned long long fuzz_rngState = FUZZ_DEFAULT_SEED;
+
+
+
+
+/*****************************************************************************/
+/* fuzz_rand - xorshift64* pseudo random number generator.                   */
+/*****************************************************************************/
+static unsigned int fuzz_rand(){
+
+	fuzz_rngState ^= fuzz_rngState >> 12;
+	fuzz_rngState ^= fuzz_rngState << 25;
+	fuzz_rngState ^= fuzz_rngState >> 27;
+
+	return (unsigned int)((fuzz_rngState * 2685821657736338717ULL) >> 32);
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_putUnit - Stores a pattern unit in native byte order.                */
+/*****************************************************************************/
+static void fuzz_putUnit(unsigned char* pDst, unsigned int val, int unitSizeBytes){
+
+	unsigned char  b = (unsigned char)val;
+	unsigned short s = (unsigned short)val;
+
+	switch(unitSizeBytes){
+		case 1:
+			memcpy(pDst,&b,1);
+			break;
+		case 2:
+			memcpy(pDst,&s,2);
+			break;
+		default:
+			memcpy(pDst,&val,4);
+	}
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_genInput - Builds an input from segments aimed at the encoders'      */
+/*                 special cases: runs at MAX_S_* lengths, literal blocks at */
+/*                 MIN_S_* and MIN_S_*+1, 2-unit vs. 3-unit run targets and  */
+/*                 odd trailing bytes for 16/32-bit.                         */
+/* Returns: number of bytes generated.                                       */
+/*****************************************************************************/
+static size_t fuzz_genInput(unsigned char* buf, size_t maxBytes, int cmprType){
+
+	int unitSizeBytes = (int)cmp_unit_size(cmprType);
+	size_t maxUnits = maxBytes / unitSizeBytes;
+	size_t numUnits = 0;
+	size_t maxRunUnits, maxLitUnits, len, x;
+	unsigned int alphabet, prev, val;
+	int numSegs, seg, trim;
+
+	val = 0;
+
+	/* Longest run token and longest literal block, in units */
+	switch(cmprType){
+		case BYTE_CMP_TYPE:
+			maxRunUnits = MAX_S_BYTE + 2;
+			maxLitUnits = -(MIN_S_BYTE);
+			break;
+		case SHORT_CMP_TYPE:
+			maxRunUnits = MAX_S_SHORT + 2;
+			maxLitUnits = -(MIN_S_SHORT);
+			break;
+		default:
+			maxRunUnits = FUZZ_MAX_RANDOM_RUN;
+			maxLitUnits = FUZZ_MAX_RANDOM_RUN;
+	}
+
+	/* Small alphabets make accidental runs likely */
+	alphabet = (fuzz_rand() % 2) ? 2 + fuzz_rand() % 3 : 0xFFFFFFFF;
+	prev = fuzz_rand() % alphabet;
+	numSegs = 1 + fuzz_rand() % 8;
+
+	for(seg = 0; (seg < numSegs) && (numUnits < maxUnits); seg++){
+		size_t litLen = 0;
+		size_t runLen = 0;
+
+		switch(fuzz_rand() % 6){
+			case 0:   /* Run around the maximum run length */
+				runLen = maxRunUnits - 1 + fuzz_rand() % 4;
+				if(fuzz_rand() % 2)
+					runLen += maxRunUnits;
+				break;
+			case 1:   /* Literal block around the maximum literal length */
+				litLen = maxLitUnits - 2 + fuzz_rand() % 4;
+				break;
+			case 2:   /* Short literal followed by a pair (3-unit target) */
+				litLen = 1 + fuzz_rand() % 4;
+				runLen = 2 + fuzz_rand() % 2;
+				break;
+			case 3:   /* Pair right at the MIN_S_*+1 literal count (2-unit target) */
+				litLen = maxLitUnits - 1 + fuzz_rand() % 2;
+				runLen = 2 + fuzz_rand() % 2;
+				break;
+			case 4:   /* Short runs */
+				runLen = 2 + fuzz_rand() % 4;
+				break;
+			default:  /* Random units */
+				len = 1 + fuzz_rand() % 64;
+				for(x = 0; (x < len) && (numUnits < maxUnits); x++){
+					prev = fuzz_rand() % alphabet;
+					fuzz_putUnit(buf + numUnits*unitSizeBytes,prev,unitSizeBytes);
+					numUnits++;
+				}
+		}
+
+		/* Literal units never repeat their neighbor */
+		for(x = 0; (x < litLen) && (numUnits < maxUnits); x++){
+			val = prev + 1 + fuzz_rand() % 7;
+			if(alphabet != 0xFFFFFFFF)
+				val = (prev + 1 + fuzz_rand() % (alphabet-1)) % alphabet;
+			prev = val;
+			fuzz_putUnit(buf + numUnits*unitSizeBytes,val,unitSizeBytes);
+			numUnits++;
+		}
+
+		/* Run of a new value */
+		if(runLen > 0){
+			val = (alphabet != 0xFFFFFFFF) ? fuzz_rand() % alphabet : fuzz_rand();
+			prev = val;
+		}
+		for(x = 0; (x < runLen) && (numUnits < maxUnits); x++){
+			fuzz_putUnit(buf + numUnits*unitSizeBytes,val,unitSizeBytes);
+			numUnits++;
+		}
+	}
+
+	/* Odd-length inputs for 16/32-bit */
+	trim = 0;
+	if((unitSizeBytes > 1) && (fuzz_rand() % 2))
+		trim = 1 + fuzz_rand() % (unitSizeBytes-1);
+	if(numUnits*unitSizeBytes <= (size_t)trim)
+		trim = 0;
+
+	return numUnits*unitSizeBytes - trim;
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_saveFailure - Saves a failing input in libFuzzer format.             */
+/*****************************************************************************/
+static void fuzz_saveFailure(const unsigned char* data, size_t sizeBytes,
+							 int cmprType)
+{
+	FILE* ofile;
+	unsigned char typeByte = (unsigned char)cmprType;
+
+	ofile = fopen(FUZZ_FAIL_FNAME,"wb");
+	if(ofile == NULL)
+		return;
+	fwrite(&typeByte,1,1,ofile);
+	fwrite(data,1,sizeBytes,ofile);
+	fclose(ofile);
+	printf("Failing input saved to %s\n",FUZZ_FAIL_FNAME);
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* fuzz_replay - Checks saved inputs in libFuzzer format.                    */
+/* Returns: number of mismatches.                                            */
+/*****************************************************************************/
+static int fuzz_replay(int numFiles, char** fnames){
+
+	static unsigned char buf[FUZZ_MAX_INPUT_BYTES+1];
+	FILE* infile;
+	size_t sizeBytes;
+	int x, numFail = 0;
+
+	for(x = 0; x < numFiles; x++){
+		infile = fopen(fnames[x],"rb");
+		if(infile == NULL){
+			printf("Error opening file %s\n",fnames[x]);
+			numFail++;
+			continue;
+		}
+		sizeBytes = fread(buf,1,sizeof(buf),infile);
+		fclose(infile);
+		if((sizeBytes >= 2) && (fuzz_check(buf+1,sizeBytes-1,buf[0] % 3) < 0))
+			numFail++;
+	}
+	printf("cmpr_fuzz: replayed %d files, %d mismatches\n",numFiles,numFail);
+
+	return numFail;
+}
+
+
+
+
+/*****************************************************************************/
+/* main - Standalone random-corpus driver.                                   */
+/*****************************************************************************/
+int main(int argc, char** argv){
+
+	static unsigned char buf[FUZZ_MAX_INPUT_BYTES];
+	long iters, x;
+	size_t sizeBytes;
+	int cmprType;
+
+	if((argc >= 2) && (strcmp(argv[1],"-r") == 0))
+		return (fuzz_replay(argc-2,argv+2) == 0) ? 0 : 1;
+
+	iters = (argc >= 2) ? atol(argv[1]) : FUZZ_DEFAULT_ITERS;
+	fuzz_rngState = (argc >= 3) ? strtoull(argv[2],NULL,0) : FUZZ_DEFAULT_SEED;
+	if(fuzz_rngState == 0)
+		fuzz_rngState = FUZZ_DEFAULT_SEED;
+
+	for(x = 0; x < iters; x++){
+		cmprType = (int)(x % 3);
+		sizeBytes = fuzz_genInput(buf,sizeof(buf),cmprType);
+		if(fuzz_check(buf,sizeBytes,cmprType) < 0){
+			printf("cmpr_fuzz: mismatch on iteration %ld\n",x);
+			fuzz_saveFailure(buf,sizeBytes,cmprType);
+			return 1;
+		}
+	}
+	printf("cmpr_fuzz: %ld cases, 0 mismatches\n",iters);
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,449 @@
+/*****************************************************************************/
+/* cmpr_ref.c - Frozen reference CMP compression routines.                   */
+/*              These are the v1.3 cmpr_8bit/16bit/32bit routines, kept      */
+/*              unchanged so that faster or restructured encoders can be     */
+/*              checked for byte-identical output (see cmpr_fuzz.c).         */
+/*              Do not modify or optimize these routines.                    */
+/*****************************************************************************/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress_rtns.h"
+#include "cmpr_ref.h"
+
+
+
+
+/*****************************************************************************/
+/* ref_cmpr_8bit - Reference 8-bit CMP Compression routine.                  */
+/* Inputs: pData, pointer to uncompressed data stream                        */
+/*         numBytes, number of 8-bit bytes in uncompr stream                 */
+/*         outData, used to allocate compressed stream                       */
+/*         comprSizeBytes, size of the compressed data stream                */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int ref_cmpr_8bit(char* pData, int numBytes, char** outData, int* cmprSizeBytes){
+
+	int i, pattDetectFlg, maxCmprSizeBytes, unitSizeBytes, runtarget;
+    unsigned int u_unmatchedCount;
+	char unmatchedCount, pattern, runLength;
+	char* pCmrData;
+	char* startLoc   = pData;
+	char* patternLoc = pData;
+	pattDetectFlg = 0;
+	unmatchedCount = 0;
+	unitSizeBytes = 1;
+	runtarget = 2;
+	*cmprSizeBytes = 0;
+
+	/* Allocate Memory for compressed data stream */
+	/* Assume the compressed data will not exceed twice the original size  */
+	/* If expansion beyond this does occur, the code that follows will abort out */
+	maxCmprSizeBytes = numBytes*unitSizeBytes*2;
+	*outData = (char*)malloc(maxCmprSizeBytes);
+	if(*outData == NULL){
+		printf("Error allocating memory for compressed data stream\n");
+		return -1;
+	}
+	pCmrData = *outData;
+
+	/* While data exists, continue to attempt compression */
+	while(numBytes > 0){
+
+	    /* For patterns, look for a run of at least 2   */
+		/* Then determine how long the pattern runs for */
+		i = 1;
+
+	    if( (numBytes >= runtarget) && 
+			( ((runtarget == 2) && (*patternLoc == *(patternLoc+i))) ||
+			( ((runtarget == 3) && (*patternLoc == *(patternLoc+i)) && (*patternLoc == *(patternLoc+i+1))) )) ){
+
+			numBytes-= runtarget;
+			i+=runtarget-1; 
+			runLength = runtarget-2;
+			runtarget = 2;
+			pattDetectFlg = 1;
+
+			while((numBytes > 0) && (runLength < MAX_S_BYTE)){
+				if(*patternLoc == *(patternLoc+i)){
+					i++;
+					runLength++;
+					numBytes--;
+				}
+				else
+					break;
+			}
+		}
+
+
+		/* If a pattern was found, write out unmatched data to the */
+		/* compression stream, followed by the pattern data        */
+		if(pattDetectFlg){
+			pattDetectFlg = 0;
+
+			/* Compression Stream - Unmatched Data */
+			if(startLoc != patternLoc){
+				u_unmatchedCount = (unsigned int)(-1*unmatchedCount);
+                *cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+				if(*cmprSizeBytes > maxCmprSizeBytes){
+					printf("Error in compression, expansion occurred.\n");
+					return -1;
+				}
+				memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+				memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+                unmatchedCount = 0;
+			}
+            
+			/* Compression Stream - Pattern Data */
+			*cmprSizeBytes += (unitSizeBytes*2);
+			if(*cmprSizeBytes > maxCmprSizeBytes){
+				printf("Error in compression, expansion occurred.\n");
+				return -1;
+			}
+			memcpy(pCmrData,&runLength,unitSizeBytes);   pCmrData++;
+			pattern = *patternLoc;
+			memcpy(pCmrData,&pattern,unitSizeBytes);     pCmrData++;
+
+			patternLoc += i;
+			startLoc = patternLoc;
+		}
+		else{
+
+			/* No new pattern was found on this comparison */
+			numBytes--;
+			patternLoc++;
+
+            /* If the number of unmatched units exceeds the maximum allowed */
+            /* then write that data to the output stream now */
+            unmatchedCount--;
+			if(unmatchedCount == MIN_S_BYTE){
+                u_unmatchedCount = (unsigned int)(-1*(unmatchedCount+(char)1)) + 1;
+				*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+				if(*cmprSizeBytes > maxCmprSizeBytes){
+					printf("Error in compression, expansion occurred.\n");
+					return -1;
+				}
+	       	    memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+		        memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+   			    startLoc = patternLoc;
+                unmatchedCount = 0;
+				runtarget = 2;
+			}
+			else if(unmatchedCount == (MIN_S_BYTE+1))
+				runtarget = 2;
+			else
+                runtarget = 3;
+		}
+	}
+
+	/* Write out any remaining unmatched data to the compression stream */
+	if(startLoc != patternLoc){
+        u_unmatchedCount = (unsigned int)(-1*unmatchedCount);
+		*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+		if(*cmprSizeBytes > maxCmprSizeBytes){
+			printf("Error in compression, expansion occurred.\n");
+			return -1;
+		}
+		memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+		memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* ref_cmpr_16bit - Reference 16-bit CMP Compression routine.                */
+/* Inputs: pData, pointer to uncompressed data stream                        */
+/*         numShorts, number of 16-bit shorts in uncompr stream (round up)   */
+/*         outData, used to allocate compressed stream                       */
+/*         comprSizeBytes, size of the compressed data stream                */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int ref_cmpr_16bit(short* pData, int numShorts, short** outData, int* cmprSizeBytes){
+
+	int i, pattDetectFlg, unitSizeBytes, maxCmprSizeBytes, runtarget;
+	unsigned int u_unmatchedCount;
+	short pattern, runLength, unmatchedCount;
+	short* pCmrData;
+	short* startLoc   = pData;
+	short* patternLoc = pData;
+	pattDetectFlg = 0;
+	unmatchedCount = 0;
+	unitSizeBytes = 2;
+	runtarget = 2;
+	*cmprSizeBytes = 0;
+
+	/* Allocate Memory for compressed data stream */
+	/* Assume the compressed data will not exceed twice the original size  */
+	/* If expansion beyond this does occur, the code that follows will abort out */
+	maxCmprSizeBytes = numShorts*unitSizeBytes*2;
+	*outData = (short*)malloc(maxCmprSizeBytes);
+	if(*outData == NULL){
+		printf("Error allocating memory for compressed data stream\n");
+		return -1;
+	}
+	pCmrData = *outData;
+
+
+	/* While data exists, continue to attempt compression */
+	while(numShorts > 0){
+
+	    /* For patterns, look for a run of at least 2   */
+		/* Then determine how long the pattern runs for */
+		i = 1;
+
+        if( (numShorts >= runtarget) && 
+			( ((runtarget == 2) && (*patternLoc == *(patternLoc+i))) ||
+			( ((runtarget == 3) && (*patternLoc == *(patternLoc+i)) && (*patternLoc == *(patternLoc+i+1))) )) ){
+
+			numShorts -= runtarget;
+			i+=runtarget-1; 
+			runLength = runtarget-2;
+			runtarget = 2;
+			pattDetectFlg = 1;
+			
+			while((numShorts > 0) && (runLength < MAX_S_SHORT)){
+				if(*patternLoc == *(patternLoc+i)){
+					i++;
+					runLength++;
+					numShorts--;
+				}
+				else
+					break;
+			}
+		}
+
+
+		/* If a pattern was found, write out unmatched data to the */
+		/* compression stream, followed by the pattern data        */
+		if(pattDetectFlg){
+			pattDetectFlg = 0;
+
+			/* Compression Stream - Unmatched Data */
+			if(startLoc != patternLoc){
+				u_unmatchedCount = (unsigned int)(-1*unmatchedCount);
+				*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+				if(*cmprSizeBytes > maxCmprSizeBytes){
+					printf("Error in compression, expansion occurred.\n");
+					return -1;
+				}
+				swap16(&unmatchedCount);
+				memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+				memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+				unmatchedCount = 0;
+			}
+
+			/* Compression Stream - Pattern Data */
+			*cmprSizeBytes += (unitSizeBytes*2);
+			if(*cmprSizeBytes > maxCmprSizeBytes){
+				printf("Error in compression, expansion occurred.\n");
+				return -1;
+			}
+
+			swap16(&runLength);
+			memcpy((char*)pCmrData,(char*)&runLength,unitSizeBytes);   pCmrData++;
+			pattern = *patternLoc;
+            swap16(&pattern);
+			memcpy((char*)pCmrData,(char*)&pattern,unitSizeBytes);     pCmrData++;
+			patternLoc += i;
+			startLoc = patternLoc;
+		}
+		else{
+
+			/* No new pattern was found on this comparison */
+			numShorts--;
+			patternLoc++;
+
+            /* If the number of unmatched units exceeds the maximum allowed */
+            /* then write that data to the output stream now */
+			unmatchedCount--;
+			if(unmatchedCount == MIN_S_SHORT){
+				u_unmatchedCount = (unsigned int)(-1*(unmatchedCount+(short)1)) + 1;
+				*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+				if(*cmprSizeBytes > maxCmprSizeBytes){
+					printf("Error in compression, expansion occurred.\n");
+					return -1;
+				}
+		        swap16(&unmatchedCount);
+	       	    memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+		        memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+   			    startLoc = patternLoc;
+				unmatchedCount = 0;
+				runtarget = 2;
+			}
+			else if(unmatchedCount == (MIN_S_SHORT+1))
+				runtarget = 2;
+			else
+				runtarget = 3;
+		}
+	}
+
+	/* Write out any remaining unmatched data to the compression stream */
+	if(startLoc != patternLoc){
+		u_unmatchedCount = (unsigned int)(-1*unmatchedCount);
+		*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+		if(*cmprSizeBytes > maxCmprSizeBytes){
+			printf("Error in compression, expansion occurred.\n");
+			return -1;
+		}
+		swap16(&unmatchedCount);
+		memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+		memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* ref_cmpr_32bit - Reference 32-bit CMP Compression routine.                */
+/* Inputs: pData, pointer to uncompressed data stream                        */
+/*         numLongs, number of 32-bit longs in uncompr stream (round up)     */
+/*         outData, used to allocate compressed stream                       */
+/*         comprSizeBytes, size of the compressed data stream                */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int ref_cmpr_32bit(int* pData, int numLongs, int** outData, int* cmprSizeBytes){
+
+	int pattern, unitSizeBytes, unmatchedCount;
+	int i, runLength, runtarget, pattDetectFlg, maxCmprSizeBytes;
+    unsigned int u_unmatchedCount;
+	int* pCmrData;
+	int* startLoc   = pData;
+	int* patternLoc = pData;
+	pattDetectFlg = 0;
+	unmatchedCount = 0;
+	unitSizeBytes = 4;
+	runtarget = 2;
+	*cmprSizeBytes = 0;
+
+	/* Allocate Memory for compressed data stream */
+	/* Assume the compressed data will not exceed twice the original size  */
+	/* If expansion beyond this does occur, the code that follows will abort out */
+	maxCmprSizeBytes = numLongs*unitSizeBytes*2;
+	*outData = (int*)malloc(maxCmprSizeBytes);
+	if(*outData == NULL){
+		printf("Error allocating memory for compressed data stream\n");
+		return -1;
+	}
+	pCmrData = *outData;
+
+
+	/* While data exists, continue to attempt compression */
+	while(numLongs > 0){
+
+	    /* For patterns, look for a run of at least 2   */
+		/* Then determine how long the pattern runs for */
+		i = 1;
+		
+        if( (numLongs >= runtarget) && 
+            ( ((runtarget == 2) && (*patternLoc == *(patternLoc+i))) ||
+            ( ((runtarget == 3) && (*patternLoc == *(patternLoc+i)) && (*patternLoc == *(patternLoc+i+1))) )) ){
+
+			numLongs-= runtarget;
+			i+=runtarget-1; 
+			runLength = runtarget-2;
+			runtarget = 2;
+			pattDetectFlg = 1;
+
+			while((numLongs > 0) && (runLength < MAX_S_LONG)){
+				if(*patternLoc == *(patternLoc+i)){
+					i++;
+					runLength++;
+					numLongs--;
+				}
+				else
+					break;
+			}
+		}
+
+
+		/* If a pattern was found, write out unmatched data to the */
+		/* compression stream, followed by the pattern data        */
+		if(pattDetectFlg){
+			pattDetectFlg = 0;
+
+			/* Compression Stream - Unmatched Data */
+			if(startLoc != patternLoc){
+				u_unmatchedCount = (unsigned int)(-1*unmatchedCount);
+				*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+				if(*cmprSizeBytes > maxCmprSizeBytes){
+					printf("Error in compression, expansion occurred.\n");
+					return -1;
+				}
+
+				swap32(&unmatchedCount);
+				memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+				memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+				unmatchedCount = 0;
+			}
+
+			/* Compression Stream - Pattern Data */
+			*cmprSizeBytes += (unitSizeBytes*2);
+			if(*cmprSizeBytes > maxCmprSizeBytes){
+				printf("Error in compression, expansion occurred.\n");
+				return -1;
+			}
+
+			swap32(&runLength);
+			memcpy(pCmrData,&runLength,unitSizeBytes);   pCmrData++;
+			pattern = *patternLoc;
+			swap32(&pattern);
+			memcpy(pCmrData,&pattern,unitSizeBytes);     pCmrData++;
+
+			patternLoc += i;
+			startLoc = patternLoc;
+		}
+		else{
+
+			/* No new pattern was found on this comparison */
+			numLongs--;
+			patternLoc++;
+
+            /* If the number of unmatched units exceeds the maximum allowed */
+            /* then write that data to the output stream now */
+			unmatchedCount--;
+			if(unmatchedCount == MIN_S_LONG){
+				u_unmatchedCount = (unsigned int)(-1*(unmatchedCount+(int)1)) + 1;
+				*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+				if(*cmprSizeBytes > maxCmprSizeBytes){
+					printf("Error in compression, expansion occurred.\n");
+					return -1;
+				}
+
+		        swap32(&unmatchedCount);
+	       	    memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+		        memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+   			    startLoc = patternLoc;
+				unmatchedCount = 0;
+				runtarget = 2;
+			}
+			else if(unmatchedCount == (MIN_S_LONG+1))
+                runtarget = 2;
+			else
+                runtarget = 3;
+		}
+	}
+
+	/* Write out any remaining unmatched data to the compression stream */
+	if(startLoc != patternLoc){
+		u_unmatchedCount = (unsigned int)(-1*unmatchedCount);
+		*cmprSizeBytes += u_unmatchedCount*unitSizeBytes + unitSizeBytes;
+		if(*cmprSizeBytes > maxCmprSizeBytes){
+			printf("Error in compression, expansion occurred.\n");
+			return -1;
+		}
+		swap32(&unmatchedCount);
+		memcpy(pCmrData,&unmatchedCount,unitSizeBytes);           pCmrData++;
+		memcpy(pCmrData,startLoc,u_unmatchedCount*unitSizeBytes); pCmrData+=u_unmatchedCount;
+	}
+
+	return 0;
+}
@@ -0,0 +1,12 @@
+/*****************************************************************************/
+/* cmpr_ref.h - Frozen reference CMP compression routines.                   */
+/*****************************************************************************/
+#ifndef CMPR_REF_H
+#define CMPR_REF_H
+
+//Fctn Prototypes
+int ref_cmpr_8bit(char* pData, int numBytes, char** outData, int* cmprSizeBytes);
+int ref_cmpr_16bit(short* pData, int numShorts, short** outData, int* cmprSizeBytes);
+int ref_cmpr_32bit(int* pData, int numLongs, int** outData, int* cmprSizeBytes);
+
+#endif
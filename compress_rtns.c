@@ -24,65 +24,440 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "compress_rtns.h"
+#include "profile.h"
+
+/* Defines */
+#define CMP_MMAP_MIN_BYTES  (16*1024*1024)  /* Map inputs at least this large */
+
+#ifdef _WIN32
+#define cmp_fseek _fseeki64
+#define cmp_ftell _ftelli64
+#else
+#define cmp_fseek fseeko
+#define cmp_ftell ftello
+#endif
 
 
 
 
 /*****************************************************************************/
 /* cmp_compress - Top Level Compression routine.                             */
+/*                The compressed stream starts CMP_MAX_HDR_BYTES into        */
+/*                *pCmprBuf, leaving room for cmp_prepend_header.            */
 /* Returns: 0 on success, -1 on failure.                                     */
 /*****************************************************************************/
-int cmp_compress(char* inputFname, unsigned int fileOffset, 
-				 int reqDataSizeBytes, int cmprType, 
-				 int* cmprSizeBytes, 
-				 int* decmprSizeBytes, 
-				 char** pCmprData)
+int cmp_compress(char* inputFname, off_t fileOffset, 
+				 size_t reqDataSizeBytes, int cmprType, 
+				 size_t* cmprSizeBytes, 
+				 size_t* decmprSizeBytes, 
+				 char** pCmprBuf)
 {
-    char* ibuffer = NULL;
-    unsigned int fsize = 0;
-	FILE* infile = NULL;
-	int sizeBytes = 0;
+	cmpInput input;
 	int rval = 0;
 
+	/* Read the data to be compressed */
+	prof_begin(PROF_PHASE_READ);
+	if(cmp_read_input(inputFname,fileOffset,reqDataSizeBytes,&input) < 0)
+		return -1;
+	*decmprSizeBytes = input.sizeBytes;
+	prof_end(PROF_PHASE_READ);
+
+	/* Compress it */
+	prof_begin(PROF_PHASE_ENCODE);
+	rval = cmp_encode(input.pData,input.sizeBytes,cmprType,
+		pCmprBuf,cmprSizeBytes);
+	prof_end(PROF_PHASE_ENCODE);
+
+	/* Free Resources */
+	cmp_free_input(&input);
+
+	return rval;
+}
+
+
+
+
+#ifndef _WIN32
+/*****************************************************************************/
+/* cmp_map_input - Memory maps the data to be compressed.  The mapping is    */
+/*                 private and writable so that the bytes used to round the  */
+/*                 data up to a whole unit can be zeroed without touching    */
+/*                 the file.                                                 */
+/* Returns: 0 on success, -1 if the data could not be mapped.                */
+/*****************************************************************************/
+static int cmp_map_input(char* inputFname, off_t fileOffset,
+						 size_t sizeBytes, cmpInput* pInput)
+{
+	long pageSize;
+	off_t mapOffset;
+	size_t lead, padBytes, lastPageBytes;
+	void* pMap;
+	int fd;
+
+	pageSize = sysconf(_SC_PAGESIZE);
+	if(pageSize <= 0)
+		return -1;
+	mapOffset = fileOffset - (fileOffset % pageSize);
+	lead = (size_t)(fileOffset - mapOffset);
+
+	/* Padding must land in a page that is backed by the file */
+	padBytes = (CMP_UNIT_PAD_BYTES - (sizeBytes % CMP_UNIT_PAD_BYTES)) % CMP_UNIT_PAD_BYTES;
+	lastPageBytes = (lead + sizeBytes) % (size_t)pageSize;
+	if( (padBytes > 0) && ((lastPageBytes == 0) ||
+		(lastPageBytes + padBytes > (size_t)pageSize)) )
+		return -1;
+
+	fd = open(inputFname,O_RDONLY);
+	if(fd < 0)
+		return -1;
+	/* Fault the pages in now, so the I/O happens on the calling (reader) */
+	/* thread rather than part way through encoding                       */
+#ifdef MAP_POPULATE
+	pMap = mmap(NULL,lead+sizeBytes+padBytes,PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_POPULATE,fd,mapOffset);
+#else
+	pMap = mmap(NULL,lead+sizeBytes+padBytes,PROT_READ|PROT_WRITE,
+		MAP_PRIVATE,fd,mapOffset);
+#endif
+	close(fd);
+	if(pMap == MAP_FAILED)
+		return -1;
+#ifndef MAP_POPULATE
+	{
+		volatile char touch;
+		size_t x;
+		madvise(pMap,lead+sizeBytes+padBytes,MADV_WILLNEED);
+		for(x = 0; x < lead+sizeBytes+padBytes; x += (size_t)pageSize)
+			touch = ((volatile char*)pMap)[x];
+		(void)touch;
+	}
+#endif
+
+	pInput->pMap = pMap;
+	pInput->mapBytes = lead+sizeBytes+padBytes;
+	pInput->pData = (char*)pMap + lead;
+	pInput->sizeBytes = sizeBytes;
+	memset(pInput->pData+sizeBytes,0,padBytes);
+
+	return 0;
+}
+#endif
+
+
+
+
+/*****************************************************************************/
+/* cmp_open_input - Opens an input file and works out how much of it to     */
+/*                  compress, applying the size limits every mode shares.    */
+/* Returns: 0 on success, 1 if the file does not exist and missingOk is set, */
+/*          -1 on failure.                                                   */
+/*****************************************************************************/
+static int cmp_open_input(char* inputFname, off_t fileOffset,
+						  size_t reqDataSizeBytes, int missingOk,
+						  FILE** pInfile, size_t* numBytes)
+{
+    off_t fsize = 0;
+	FILE* infile = NULL;
+
 	/* Open the input file for reading */
 	infile = fopen(inputFname,"rb");
 	if(infile == NULL){
+		if(missingOk && (errno == ENOENT))
+			return 1;
 		printf("Error opening file %s\n",inputFname);
 		return -1;
 	}
 
-	/* Allocate memory for the input data to be compressed */
-	fseek(infile,0,SEEK_END);
-	fsize = ftell(infile);
-	if(reqDataSizeBytes == 0)
-		sizeBytes = fsize-fileOffset;
-	else
-		sizeBytes = reqDataSizeBytes;
-	ibuffer = (char*)malloc(sizeBytes);
-	if(ibuffer == NULL){
-		printf("Error allocing memory for input data\n");
+	/* Determine the amount of data to be compressed */
+	cmp_fseek(infile,0,SEEK_END);
+	fsize = cmp_ftell(infile);
+	if((fsize < 0) || (fileOffset < 0) || (fileOffset >= fsize)){
+		printf("Error reading from input file\n");
+		fclose(infile);
+		return -1;
+	}
+	*numBytes = (size_t)(fsize-fileOffset);
+	if((reqDataSizeBytes != 0) && (reqDataSizeBytes < *numBytes))
+		*numBytes = reqDataSizeBytes;
+	if(*numBytes > CMP_MAX_INPUT_BYTES){
+		printf("Error, input too large to compress\n");
+		fclose(infile);
+		return -1;
+	}
+
+	/* The header cannot describe more, so fail before reading it all */
+	if((unsigned long long)*numBytes > CMP_MAX_HDR_SIZE){
+		printf("Error, %s has more data than the 32-bit header field can hold,"
+			" use -s to compress part of it\n",inputFname);
+		fclose(infile);
 		return -1;
 	}
 
+	/* Saturn CD is only going to have at most 700MB */
+	if((unsigned long long)*numBytes > CMP_CD_SIZE_BYTES)
+		printf("Warning, %s data size > 700MB\n",inputFname);
+
+	*pInfile = infile;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_fread_input - Reads the data to be compressed from an open input and  */
+/*                   zero pads it to a whole 32-bit unit.  Closes the file.  */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int cmp_fread_input(FILE* infile, off_t fileOffset, char* ibuffer,
+						   size_t* numBytes)
+{
 	/* Jump to starting offset of input file and read */
 	/* the data to be compressed to a buffer */
-	fseek(infile,fileOffset,SEEK_SET);
-	sizeBytes = fread(ibuffer,1,sizeBytes,infile);
+	cmp_fseek(infile,fileOffset,SEEK_SET);
+	*numBytes = fread(ibuffer,1,*numBytes,infile);
 	fclose(infile);
-	if(sizeBytes <= 0){
+	if(*numBytes == 0){
 		printf("Error reading from input file\n");
 		return -1;
 	}
-	*decmprSizeBytes = sizeBytes;
+	memset(ibuffer+*numBytes,0,CMP_UNIT_PAD_BYTES);
 
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_read_input - Reads the data to be compressed from the input file.     */
+/*                  Large inputs are memory mapped instead of copied.  The   */
+/*                  data is zero padded to a whole 32-bit unit.              */
+/* Inputs: inputFname, file to read                                          */
+/*         fileOffset, byte offset in the file to begin reading              */
+/*         reqDataSizeBytes, bytes to read (0 = to end of file)              */
+/*         pInput, filled in with the data, free with cmp_free_input         */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int cmp_read_input(char* inputFname, off_t fileOffset,
+				   size_t reqDataSizeBytes, cmpInput* pInput)
+{
+    char* ibuffer = NULL;
+	FILE* infile = NULL;
+	size_t numBytes = 0;
+
+	memset(pInput,0,sizeof(cmpInput));
+	if(cmp_open_input(inputFname,fileOffset,reqDataSizeBytes,0,&infile,&numBytes) != 0)
+		return -1;
+
+#ifndef _WIN32
+	/* Map large inputs rather than duplicating them in memory.  The */
+	/* mapping is page aligned, so the data is only aligned for the  */
+	/* 16/32-bit encoders if the offset is a multiple of a unit.     */
+	if((numBytes >= CMP_MMAP_MIN_BYTES) && ((fileOffset % CMP_UNIT_PAD_BYTES) == 0)){
+		if(cmp_map_input(inputFname,fileOffset,numBytes,pInput) == 0){
+			fclose(infile);
+			return 0;
+		}
+	}
+#endif
+
+	/* Allocate memory for the input data to be compressed */
+	ibuffer = (char*)malloc(numBytes + CMP_UNIT_PAD_BYTES);
+	if(ibuffer == NULL){
+		printf("Error allocing memory for input data\n");
+		fclose(infile);
+		return -1;
+	}
+	if(cmp_fread_input(infile,fileOffset,ibuffer,&numBytes) < 0){
+		free(ibuffer);
+		return -1;
+	}
+
+	pInput->pData = ibuffer;
+	pInput->sizeBytes = numBytes;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_read_input_buf - As cmp_read_input, but always reads into a buffer    */
+/*                      the caller owns, growing it only when needed, so it  */
+/*                      stays warm across inputs.  pInput points into the    */
+/*                      buffer and must not be passed to cmp_free_input.     */
+/* Inputs: pBuf/bufCapBytes, the caller's buffer and its size, updated if    */
+/*                           the buffer grows                                */
+/* Returns: 0 on success, 1 if the file does not exist, -1 on failure.       */
+/*****************************************************************************/
+int cmp_read_input_buf(char* inputFname, off_t fileOffset,
+					   size_t reqDataSizeBytes, char** pBuf,
+					   size_t* bufCapBytes, cmpInput* pInput)
+{
+	FILE* infile = NULL;
+	size_t numBytes = 0;
+	char* tmp;
+	int rval;
+
+	memset(pInput,0,sizeof(cmpInput));
+	rval = cmp_open_input(inputFname,fileOffset,reqDataSizeBytes,1,&infile,&numBytes);
+	if(rval != 0)
+		return rval;
+
+	if((numBytes + CMP_UNIT_PAD_BYTES) > *bufCapBytes){
+		tmp = (char*)realloc(*pBuf,numBytes + CMP_UNIT_PAD_BYTES);
+		if(tmp == NULL){
+			printf("Error allocing memory for input data\n");
+			fclose(infile);
+			return -1;
+		}
+		*pBuf = tmp;
+		*bufCapBytes = numBytes + CMP_UNIT_PAD_BYTES;
+	}
+	if(cmp_fread_input(infile,fileOffset,*pBuf,&numBytes) < 0)
+		return -1;
+
+	pInput->pData = *pBuf;
+	pInput->sizeBytes = numBytes;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_free_input - Releases data returned by cmp_read_input.                */
+/*****************************************************************************/
+void cmp_free_input(cmpInput* pInput){
+
+#ifndef _WIN32
+	if(pInput->pMap != NULL)
+		munmap(pInput->pMap,pInput->mapBytes);
+	else
+#endif
+		free(pInput->pData);
+	memset(pInput,0,sizeof(cmpInput));
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_unit_size - Returns the pattern size in bytes for a compression type. */
+/*****************************************************************************/
+size_t cmp_unit_size(int cmprType){
+
+	switch(cmprType){
+		case SHORT_CMP_TYPE:
+			return 2;
+		case LONG_CMP_TYPE:
+			return 4;
+		default:
+			return 1;
+	}
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_max_cmpr_size - Worst case compressed stream size for an input.       */
+/* Returns: size in bytes, 0 if the input is too large to compress.          */
+/*****************************************************************************/
+size_t cmp_max_cmpr_size(size_t sizeBytes, int cmprType){
+
+	size_t unitSizeBytes, numUnits;
+
+	unitSizeBytes = cmp_unit_size(cmprType);
+	if(sizeBytes > CMP_MAX_INPUT_BYTES)
+		return 0;
+	numUnits = (sizeBytes + unitSizeBytes - 1) / unitSizeBytes;
+
+	return CMP_MAX_CMPR_UNITS(numUnits)*unitSizeBytes;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_encode - Compresses a buffer based on the selected pattern length.    */
+/* Inputs: ibuffer, uncompressed data                                        */
+/*         sizeBytes, number of bytes of uncompressed data                   */
+/*         cmprType, BYTE_CMP_TYPE, SHORT_CMP_TYPE or LONG_CMP_TYPE          */
+/*         pCmprBuf, used to allocate the output buffer.  The compressed     */
+/*                   stream starts CMP_MAX_HDR_BYTES into the buffer so the  */
+/*                   header can be placed in front of it without a copy.     */
+/*         cmprSizeBytes, size of the compressed data stream                 */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int cmp_encode(char* ibuffer, size_t sizeBytes, int cmprType,
+			   char** pCmprBuf, size_t* cmprSizeBytes)
+{
+	size_t maxCmprSizeBytes;
+
+	/* Allocate the output buffer, with room for the header in front */
+	*pCmprBuf = NULL;
+	maxCmprSizeBytes = cmp_max_cmpr_size(sizeBytes,cmprType);
+	if(maxCmprSizeBytes == 0){
+		printf("Error, input too large to compress\n");
+		return -1;
+	}
+	*pCmprBuf = (char*)malloc(CMP_MAX_HDR_BYTES + maxCmprSizeBytes);
+	if(*pCmprBuf == NULL){
+		printf("Error allocating memory for compressed data stream\n");
+		return -1;
+	}
+
+	/* Compress into the space after the header */
+	if(cmp_encode_into(ibuffer,sizeBytes,cmprType,*pCmprBuf + CMP_MAX_HDR_BYTES,
+		maxCmprSizeBytes,cmprSizeBytes) < 0){
+		free(*pCmprBuf);
+		*pCmprBuf = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_encode_into - Compresses a buffer into a caller supplied stream       */
+/*                   buffer, so long-lived callers can reuse it.             */
+/* Inputs: ibuffer/sizeBytes/cmprType, as for cmp_encode                     */
+/*         pCmprData, output stream buffer                                   */
+/*         maxCmprSizeBytes, size of pCmprData, at least cmp_max_cmpr_size() */
+/*         cmprSizeBytes, size of the compressed data stream                 */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int cmp_encode_into(char* ibuffer, size_t sizeBytes, int cmprType,
+					char* pCmprData, size_t maxCmprSizeBytes,
+					size_t* cmprSizeBytes)
+{
+	int rval = 0;
 
 	/* Compress Based on Selected Pattern Length: 8/16/32-bit */
 	switch(cmprType){
 
 		case BYTE_CMP_TYPE:
 		{
-			if(cmpr_8bit(ibuffer,sizeBytes,pCmprData,cmprSizeBytes) < 0){
+			if(cmpr_8bit(ibuffer,sizeBytes,pCmprData,
+				maxCmprSizeBytes,cmprSizeBytes) < 0){
 				printf("8-bit compression failed.\n");
 				rval = -1;
 			}
@@ -91,12 +466,12 @@ int cmp_compress(char* inputFname, unsigned int fileOffset,
 
 		case SHORT_CMP_TYPE:
 		{
-			int numShorts = 0;
+			size_t numShorts = 0;
 			numShorts = sizeBytes / 2;
 			if((sizeBytes % 2) != 0)
 				numShorts++;
-			if(cmpr_16bit((short*)ibuffer,numShorts,
-				(short**)pCmprData,cmprSizeBytes) < 0){
+			if(cmpr_16bit((short*)ibuffer,numShorts,(short*)pCmprData,
+				maxCmprSizeBytes,cmprSizeBytes) < 0){
 				printf("16-bit compression failed.\n");
 				rval = -1;
 			}
@@ -105,12 +480,12 @@ int cmp_compress(char* inputFname, unsigned int fileOffset,
 
 		case LONG_CMP_TYPE:
 		{
-			int numLongs = 0;
+			size_t numLongs = 0;
 			numLongs = sizeBytes / 4;
 			if((sizeBytes % 4) != 0)
 				numLongs++;
-			if(cmpr_32bit((int*)ibuffer,numLongs,
-				(int**)pCmprData,cmprSizeBytes) < 0){
+			if(cmpr_32bit((int*)ibuffer,numLongs,(int*)pCmprData,
+				maxCmprSizeBytes,cmprSizeBytes) < 0){
 				printf("32-bit compression failed.\n");
 				rval = -1;
 			}
@@ -122,11 +497,177 @@ int cmp_compress(char* inputFname, unsigned int fileOffset,
 			rval = -1;
 	}
 
-	/* Free Resources */
-	if(ibuffer != NULL)
-		free(ibuffer);
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_build_header - Constructs the compression header.                     */
+/* Inputs: cmprType, BYTE_CMP_TYPE, SHORT_CMP_TYPE or LONG_CMP_TYPE          */
+/*         decmprSizeBytes, size of the uncompressed data                    */
+/*         forceHdrSize32, non-zero to always use a 32-bit size field        */
+/*         pHdr, buffer of at least CMP_MAX_HDR_BYTES to hold the header     */
+/* Returns: size of the header in bytes, -1 if the size does not fit.        */
+/*****************************************************************************/
+int cmp_build_header(int cmprType, size_t decmprSizeBytes, int forceHdrSize32,
+					 char* pHdr)
+{
+	unsigned short* pUshortHdr;
+	unsigned short hdrWord0;
+	int hdrSizeBytes;
+
+	///////////////////////////////////////////////////////////////////////////
+	// Header Format - Variable Length (32-bits or 64-bits)
+	// Word 0 [16-bits]
+    //   Compression Type
+	//   Value:  0000_YY00 0000_Z000
+    //           where: YY = 00 (8-bit RLE), 01 (16-bit RLE), 10 (32-bit RLE)
+	//                  Z determines format of the rest of the header
+	//
+    // If Z = 0:
+	// Word 1 [16-bits]
+	//   Decompression Size in Bytes.
+	// End of Header
+	//
+	// If Z = 1:
+	// Word 1 [16-bits]
+	//   16-bit padding.  Required for alignment of the 32-bit size to follow
+	// Words 2,3 [Combine for 32-bit LW]
+	//   Decompression Size in Bytes.
+	// End of Header
+    ///////////////////////////////////////////////////////////////////////////
+	if(decmprSizeBytes > CMP_MAX_HDR_SIZE){
+		printf("Error, data size does not fit in the 32-bit header field\n");
+		return -1;
+	}
+	hdrWord0 = 0;
+	pUshortHdr = &hdrWord0;
+	memset(pHdr,0,CMP_MAX_HDR_BYTES);  /* Zero the header */
+
+	/* Fill in the compression type */
+	switch(cmprType){
+		case BYTE_CMP_TYPE:
+			*pUshortHdr = HDR_BYTE_CMP;
+			break;
+		case SHORT_CMP_TYPE:
+			*pUshortHdr = HDR_WORD_CMP;
+			break;
+		case LONG_CMP_TYPE:
+			*pUshortHdr = HDR_LONG_CMP;
+			break;
+	}
+
+	/* Set flag indictating that 2 or 4 bytes are set */
+	/* Aside in the header for the decompressed size  */
+	/* If 4 bytes, then 2 bytes of padding exist between the */
+	/* header and size information */
+	/* Also copy in the size information */
+	if(forceHdrSize32 || (decmprSizeBytes > 65535)){
+		unsigned int long_decmprSize = (unsigned int)decmprSizeBytes;
+		*pUshortHdr |= HDR_SIZE_4BYTE;
+		swap16(pUshortHdr);
+		swap32(&long_decmprSize);
+		memcpy(pHdr+4,&long_decmprSize,4);
+		hdrSizeBytes = 8;
+	}
+	else{
+		unsigned short shrt_decmprSize = (unsigned short)decmprSizeBytes;
+		swap16(pUshortHdr);
+		swap16(&shrt_decmprSize);
+		memcpy(pHdr+2,&shrt_decmprSize,2);
+		hdrSizeBytes = 4;
+	}
+	memcpy(pHdr,pUshortHdr,2);
+
+	return hdrSizeBytes;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_prepend_header - Builds the header directly in front of the           */
+/*                      compressed stream in a buffer from cmp_encode, so    */
+/*                      header and data can be written out in one piece.     */
+/* Inputs: pCmprBuf, output buffer from cmp_encode                           */
+/*         cmprType/decmprSizeBytes/forceHdrSize32, see cmp_build_header     */
+/*         hdrSizeBytes, size of the header placed in the buffer             */
+/* Returns: start of the header, NULL on failure.                            */
+/*****************************************************************************/
+char* cmp_prepend_header(char* pCmprBuf, int cmprType, size_t decmprSizeBytes,
+						 int forceHdrSize32, int* hdrSizeBytes)
+{
+	char hdr[CMP_MAX_HDR_BYTES];
+	char* pOut;
+
+	*hdrSizeBytes = cmp_build_header(cmprType,decmprSizeBytes,
+		forceHdrSize32,hdr);
+	if(*hdrSizeBytes < 0)
+		return NULL;
+	pOut = pCmprBuf + CMP_MAX_HDR_BYTES - *hdrSizeBytes;
+	memcpy(pOut,hdr,*hdrSizeBytes);
+
+	return pOut;
+}
+
+
+
+
+/*****************************************************************************/
+/* cmp_write_output - Writes a header and compressed data to a file with a   */
+/*                    single unbuffered write where available.               */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int cmp_write_output(char* outputFname, char* pOutData, size_t outSizeBytes){
+
+#ifndef _WIN32
+	ssize_t numWritten;
+	int fd;
+
+	fd = open(outputFname,O_WRONLY|O_CREAT|O_TRUNC,0666);
+	if(fd < 0){
+		printf("Error opening output file for writing.\n");
+		return -1;
+	}
+	while(outSizeBytes > 0){
+		numWritten = write(fd,pOutData,outSizeBytes);
+		if(numWritten < 0){
+			if(errno == EINTR)
+				continue;
+			printf("Error writing output file.\n");
+			close(fd);
+			return -1;
+		}
+		pOutData += numWritten;
+		outSizeBytes -= (size_t)numWritten;
+	}
+	if(close(fd) < 0){
+		printf("Error writing output file.\n");
+		return -1;
+	}
+
+	return 0;
+#else
+	FILE* ofile = NULL;
+	int rval = 0;
+
+	ofile = fopen(outputFname,"wb");
+	if(ofile == NULL){
+		printf("Error opening output file for writing.\n");
+		return -1;
+	}
+	setvbuf(ofile,NULL,_IONBF,0);
+	if(fwrite(pOutData,1,outSizeBytes,ofile) != outSizeBytes){
+		printf("Error writing output file.\n");
+		rval = -1;
+	}
+	if(fclose(ofile) != 0)
+		rval = -1;
 
 	return rval;
+#endif
 }
 
 
@@ -136,14 +677,16 @@ int cmp_compress(char* inputFname, unsigned int fileOffset,
 /* cmpr_8bit - 8-bit CMP Compression routine.                                */
 /* Inputs: pData, pointer to uncompressed data stream                        */
 /*         numBytes, number of 8-bit bytes in uncompr stream                 */
-/*         outData, used to allocate compressed stream                       */
+/*         outData, buffer to hold the compressed stream                     */
+/*         maxCmprSizeBytes, size of outData, see cmp_max_cmpr_size          */
 /*         comprSizeBytes, size of the compressed data stream                */
 /* Returns: 0 on success, -1 on failure.                                     */
 /*****************************************************************************/
-int cmpr_8bit(char* pData, int numBytes, char** outData, int* cmprSizeBytes){
+int cmpr_8bit(char* pData, size_t numBytes, char* outData,
+			  size_t maxCmprSizeBytes, size_t* cmprSizeBytes){
 
-	int i, pattDetectFlg, maxCmprSizeBytes, unitSizeBytes, runtarget;
-    unsigned int u_unmatchedCount;
+	int pattDetectFlg, unitSizeBytes, runtarget;
+	size_t i, u_unmatchedCount;
 	char unmatchedCount, pattern, runLength;
 	char* pCmrData;
 	char* startLoc   = pData;
@@ -154,16 +697,9 @@ int cmpr_8bit(char* pData, int numBytes, char** outData, int* cmprSizeBytes){
 	runtarget = 2;
 	*cmprSizeBytes = 0;
 
-	/* Allocate Memory for compressed data stream */
-	/* Assume the compressed data will not exceed twice the original size  */
-	/* If expansion beyond this does occur, the code that follows will abort out */
-	maxCmprSizeBytes = numBytes*unitSizeBytes*2;
-	*outData = (char*)malloc(maxCmprSizeBytes);
-	if(*outData == NULL){
-		printf("Error allocating memory for compressed data stream\n");
-		return -1;
-	}
-	pCmrData = *outData;
+	/* Compressed data stream is written to the caller's buffer */
+	/* If expansion beyond its size occurs, the code that follows will abort out */
+	pCmrData = outData;
 
 	/* While data exists, continue to attempt compression */
 	while(numBytes > 0){
@@ -172,11 +708,11 @@ int cmpr_8bit(char* pData, int numBytes, char** outData, int* cmprSizeBytes){
 		/* Then determine how long the pattern runs for */
 		i = 1;
 
-	    if( (numBytes >= runtarget) && 
+	    if( (numBytes >= (size_t)runtarget) && 
 			( ((runtarget == 2) && (*patternLoc == *(patternLoc+i))) ||
 			( ((runtarget == 3) && (*patternLoc == *(patternLoc+i)) && (*patternLoc == *(patternLoc+i+1))) )) ){
 
-			numBytes-= runtarget;
+			numBytes -= (size_t)runtarget;
 			i+=runtarget-1; 
 			runLength = runtarget-2;
 			runtarget = 2;
@@ -276,14 +812,16 @@ int cmpr_8bit(char* pData, int numBytes, char** outData, int* cmprSizeBytes){
 /* cmpr_16bit - 16-bit CMP Compression routine.                              */
 /* Inputs: pData, pointer to uncompressed data stream                        */
 /*         numShorts, number of 16-bit shorts in uncompr stream (round up)   */
-/*         outData, used to allocate compressed stream                       */
+/*         outData, buffer to hold the compressed stream                     */
+/*         maxCmprSizeBytes, size of outData, see cmp_max_cmpr_size          */
 /*         comprSizeBytes, size of the compressed data stream                */
 /* Returns: 0 on success, -1 on failure.                                     */
 /*****************************************************************************/
-int cmpr_16bit(short* pData, int numShorts, short** outData, int* cmprSizeBytes){
+int cmpr_16bit(short* pData, size_t numShorts, short* outData,
+			   size_t maxCmprSizeBytes, size_t* cmprSizeBytes){
 
-	int i, pattDetectFlg, unitSizeBytes, maxCmprSizeBytes, runtarget;
-	unsigned int u_unmatchedCount;
+	int pattDetectFlg, unitSizeBytes, runtarget;
+	size_t i, u_unmatchedCount;
 	short pattern, runLength, unmatchedCount;
 	short* pCmrData;
 	short* startLoc   = pData;
@@ -294,16 +832,9 @@ int cmpr_16bit(short* pData, int numShorts, short** outData, int* cmprSizeBytes)
 	runtarget = 2;
 	*cmprSizeBytes = 0;
 
-	/* Allocate Memory for compressed data stream */
-	/* Assume the compressed data will not exceed twice the original size  */
-	/* If expansion beyond this does occur, the code that follows will abort out */
-	maxCmprSizeBytes = numShorts*unitSizeBytes*2;
-	*outData = (short*)malloc(maxCmprSizeBytes);
-	if(*outData == NULL){
-		printf("Error allocating memory for compressed data stream\n");
-		return -1;
-	}
-	pCmrData = *outData;
+	/* Compressed data stream is written to the caller's buffer */
+	/* If expansion beyond its size occurs, the code that follows will abort out */
+	pCmrData = outData;
 
 
 	/* While data exists, continue to attempt compression */
@@ -313,11 +844,11 @@ int cmpr_16bit(short* pData, int numShorts, short** outData, int* cmprSizeBytes)
 		/* Then determine how long the pattern runs for */
 		i = 1;
 
-        if( (numShorts >= runtarget) && 
+        if( (numShorts >= (size_t)runtarget) && 
 			( ((runtarget == 2) && (*patternLoc == *(patternLoc+i))) ||
 			( ((runtarget == 3) && (*patternLoc == *(patternLoc+i)) && (*patternLoc == *(patternLoc+i+1))) )) ){
 
-			numShorts -= runtarget;
+			numShorts -= (size_t)runtarget;
 			i+=runtarget-1; 
 			runLength = runtarget-2;
 			runtarget = 2;
@@ -422,15 +953,17 @@ int cmpr_16bit(short* pData, int numShorts, short** outData, int* cmprSizeBytes)
 /* cmpr_32bit - 32-bit CMP Compression routine.                              */
 /* Inputs: pData, pointer to uncompressed data stream                        */
 /*         numLongs, number of 32-bit longs in uncompr stream (round up)     */
-/*         outData, used to allocate compressed stream                       */
+/*         outData, buffer to hold the compressed stream                     */
+/*         maxCmprSizeBytes, size of outData, see cmp_max_cmpr_size          */
 /*         comprSizeBytes, size of the compressed data stream                */
 /* Returns: 0 on success, -1 on failure.                                     */
 /*****************************************************************************/
-int cmpr_32bit(int* pData, int numLongs, int** outData, int* cmprSizeBytes){
+int cmpr_32bit(int* pData, size_t numLongs, int* outData,
+			   size_t maxCmprSizeBytes, size_t* cmprSizeBytes){
 
 	int pattern, unitSizeBytes, unmatchedCount;
-	int i, runLength, runtarget, pattDetectFlg, maxCmprSizeBytes;
-    unsigned int u_unmatchedCount;
+	int runLength, runtarget, pattDetectFlg;
+	size_t i, u_unmatchedCount;
 	int* pCmrData;
 	int* startLoc   = pData;
 	int* patternLoc = pData;
@@ -440,16 +973,9 @@ int cmpr_32bit(int* pData, int numLongs, int** outData, int* cmprSizeBytes){
 	runtarget = 2;
 	*cmprSizeBytes = 0;
 
-	/* Allocate Memory for compressed data stream */
-	/* Assume the compressed data will not exceed twice the original size  */
-	/* If expansion beyond this does occur, the code that follows will abort out */
-	maxCmprSizeBytes = numLongs*unitSizeBytes*2;
-	*outData = (int*)malloc(maxCmprSizeBytes);
-	if(*outData == NULL){
-		printf("Error allocating memory for compressed data stream\n");
-		return -1;
-	}
-	pCmrData = *outData;
+	/* Compressed data stream is written to the caller's buffer */
+	/* If expansion beyond its size occurs, the code that follows will abort out */
+	pCmrData = outData;
 
 
 	/* While data exists, continue to attempt compression */
@@ -459,11 +985,11 @@ int cmpr_32bit(int* pData, int numLongs, int** outData, int* cmprSizeBytes){
 		/* Then determine how long the pattern runs for */
 		i = 1;
 		
-        if( (numLongs >= runtarget) && 
+        if( (numLongs >= (size_t)runtarget) && 
             ( ((runtarget == 2) && (*patternLoc == *(patternLoc+i))) ||
             ( ((runtarget == 3) && (*patternLoc == *(patternLoc+i)) && (*patternLoc == *(patternLoc+i+1))) )) ){
 
-			numLongs-= runtarget;
+			numLongs -= (size_t)runtarget;
 			i+=runtarget-1; 
 			runLength = runtarget-2;
 			runtarget = 2;
@@ -563,3 +1089,26 @@ int cmpr_32bit(int* pData, int numLongs, int** outData, int* cmprSizeBytes){
 
 	return 0;
 }
+
+
+
+
+#ifndef _WIN32
+/*****************************************************************************/
+/* cmp_mtime_nsec - Nanosecond part of a file's modification time.  The      */
+/*                  field is named differently on macOS, and platforms       */
+/*                  without it fall back to whole seconds.                   */
+/*****************************************************************************/
+long cmp_mtime_nsec(const struct stat* pSt){
+
+#if defined(__APPLE__)
+	return (long)pSt->st_mtimespec.tv_nsec;
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || \
+	  defined(__OpenBSD__)
+	return (long)pSt->st_mtim.tv_nsec;
+#else
+	(void)pSt;
+	return 0;
+#endif
+}
+#endif
@@ -4,11 +4,35 @@
 #ifndef COMPRESS_RTNS_H
 #define COMPRESS_RTNS_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
 //Defines
 #define BYTE_CMP_TYPE  0   //1-byte RLE Pattern Compression
 #define SHORT_CMP_TYPE 1  //2-byte RLE Pattern Compression
 #define LONG_CMP_TYPE  2   //4-byte RLE Pattern Compression
 
+//Header Defines
+#define HDR_BYTE_CMP    0x0000
+#define HDR_WORD_CMP    0x0400
+#define HDR_LONG_CMP    0x0C00
+#define HDR_SIZE_4BYTE  0x0008
+#define CMP_MAX_HDR_BYTES 8               //Also space reserved ahead of the stream
+#define CMP_MAX_HDR_SIZE  0xFFFFFFFFUL   //Largest size the header can hold
+
+//Encoder Properties
+#define CMP_UNIT_PAD_BYTES  4   //Input is zero padded to a whole 32-bit unit
+#define CMP_LOOKAHEAD_UNITS 2   //Units read past the end of a token's decision
+
+//Size Limits
+//Worst case compressed size in units for n input units.  Each maximum
+//length literal block costs one extra unit, plus the final block.
+#define CMP_MAX_CMPR_UNITS(n)  ((n) + ((n) / 64) + 4)
+#define CMP_MAX_INPUT_BYTES    (SIZE_MAX / 2)
+#define CMP_CD_SIZE_BYTES      (700ULL*1024*1024)  //Saturn CD capacity
+
 #define swap16(a)   *a = ((*a >> 8) & 0x00FF) | \
 	                     ((*a << 8) & 0xFF00)
 
@@ -25,15 +49,47 @@
 #define MIN_S_SHORT		-32768
 #define MIN_S_LONG		(-2147483647 - 1)
 
+//Input data returned by cmp_read_input
+typedef struct{
+	char*  pData;       //Data to compress, zero padded to a 32-bit unit
+	size_t sizeBytes;   //Number of bytes of data
+	void*  pMap;        //Base of the mapping if memory mapped, else NULL
+	size_t mapBytes;    //Length of the mapping
+}cmpInput;
+
 //Fctn Prototypes
-int cmp_compress(char* inputFname, unsigned int fileOffset, 
-				 int dataSizeBytes, int cmprType, 
-				 int* cmprSizeBytes, 
-				 int* decmprSizeBytes, 
-				 char** pCmprData);
-
-int cmpr_8bit(char* pData, int numBytes, char** outData, int* cmprSizeBytes);
-int cmpr_16bit(short* pData, int numShorts, short** outData, int* cmprSizeBytes);
-int cmpr_32bit(int* pData, int numLongs, int** outData, int* cmprSizeBytes);
+int cmp_compress(char* inputFname, off_t fileOffset, 
+				 size_t dataSizeBytes, int cmprType, 
+				 size_t* cmprSizeBytes, 
+				 size_t* decmprSizeBytes, 
+				 char** pCmprBuf);
+int cmp_read_input(char* inputFname, off_t fileOffset,
+				   size_t reqDataSizeBytes, cmpInput* pInput);
+int cmp_read_input_buf(char* inputFname, off_t fileOffset,
+					   size_t reqDataSizeBytes, char** pBuf,
+					   size_t* bufCapBytes, cmpInput* pInput);
+void cmp_free_input(cmpInput* pInput);
+size_t cmp_unit_size(int cmprType);
+size_t cmp_max_cmpr_size(size_t sizeBytes, int cmprType);
+int cmp_encode(char* ibuffer, size_t sizeBytes, int cmprType,
+			   char** pCmprBuf, size_t* cmprSizeBytes);
+int cmp_encode_into(char* ibuffer, size_t sizeBytes, int cmprType,
+					char* pCmprData, size_t maxCmprSizeBytes,
+					size_t* cmprSizeBytes);
+int cmp_build_header(int cmprType, size_t decmprSizeBytes, int forceHdrSize32,
+					 char* pHdr);
+char* cmp_prepend_header(char* pCmprBuf, int cmprType, size_t decmprSizeBytes,
+						 int forceHdrSize32, int* hdrSizeBytes);
+int cmp_write_output(char* outputFname, char* pOutData, size_t outSizeBytes);
+#ifndef _WIN32
+long cmp_mtime_nsec(const struct stat* pSt);
+#endif
+
+int cmpr_8bit(char* pData, size_t numBytes, char* outData,
+			  size_t maxCmprSizeBytes, size_t* cmprSizeBytes);
+int cmpr_16bit(short* pData, size_t numShorts, short* outData,
+			   size_t maxCmprSizeBytes, size_t* cmprSizeBytes);
+int cmpr_32bit(int* pData, size_t numLongs, int* outData,
+			   size_t maxCmprSizeBytes, size_t* cmprSizeBytes);
 
 #endif
@@ -0,0 +1,940 @@
+/*****************************************************************************/
+/* incremental.c - Incremental re-encoding by token stream splicing.         */
+/*                 A sidecar index next to each output records hashes of the */
+/*                 input blocks and a sparse set of resync points.  When the */
+/*                 input is edited, only the tokens around the changed       */
+/*                 blocks are re-encoded and spliced into the old stream.    */
+/*                 The result is byte-identical to a full compress.          */
+/*****************************************************************************/
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Resync Points                                                             //
+// The encoder returns to its initial state after every run token and after  //
+// every literal token of maximum length (count == MIN_S_*).  Encoding from  //
+// such a point depends only on the input from that point on, and each       //
+// decision reads at most 2 units ahead of the current position.  So:        //
+//                                                                           //
+//  - A point at unit u is still valid after an edit starting at unit a if   //
+//    u + 2 <= a.  Re-encoding can start there.                              //
+//  - Encoding a window [s, w) reproduces every token ending at or before    //
+//    w - 2, as long as s is a resync point.                                 //
+//  - Once the new encoding passes the end of an edit and lands on a resync  //
+//    point the old stream also has, the rest of the old stream is reused.   //
+///////////////////////////////////////////////////////////////////////////////
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Sidecar Index Format (host byte order, unsigned 64-bit fields)            //
+//                                                                           //
+// | magic | version | cmprType | forceHdrSize32 | fileOffset | reqSize |    //
+// | inputSize | cmprSize | hdrSize | mtimeSec | mtimeNsec | blockBytes |    //
+// | numBlocks | numPoints | block hashes ... | points (unit, out) ... |     //
+//                                                                           //
+// The output file's size and mtime are recorded so an output changed by     //
+// anything else is detected and fully recompressed.                         //
+///////////////////////////////////////////////////////////////////////////////
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress_rtns.h"
+#include "incremental.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+/* Defines */
+#define INCR_MAGIC          0x5844494E504D43ULL   /* "CMPNIDX" */
+#define INCR_VERSION        1
+#define INCR_FNV_OFFSET     0xCBF29CE484222325ULL
+#define INCR_FNV_PRIME      0x100000001B3ULL
+
+/* Sidecar index header */
+typedef struct{
+	unsigned long long magic;
+	unsigned long long version;
+	unsigned long long cmprType;
+	unsigned long long forceHdrSize32;
+	unsigned long long fileOffset;
+	unsigned long long reqSizeBytes;
+	unsigned long long inputSizeBytes;
+	unsigned long long cmprSizeBytes;
+	unsigned long long hdrSizeBytes;
+	unsigned long long mtimeSec;
+	unsigned long long mtimeNsec;
+	unsigned long long blockBytes;
+	unsigned long long numBlocks;
+	unsigned long long numPoints;
+}incrIdxHdr;
+
+/* Growable array of points */
+typedef struct{
+	incrPoint* pts;
+	size_t     count;
+	size_t     maxCount;
+}incrPointList;
+
+
+
+
+/*****************************************************************************/
+/* incr_parse_token - Decodes the token at the start of a compressed stream. */
+/* Inputs: pToken, start of the token                                        */
+/*         bytesLeft, bytes remaining in the stream                          */
+/*         cmprType, BYTE_CMP_TYPE, SHORT_CMP_TYPE or LONG_CMP_TYPE          */
+/*         numUnits, set to the number of input units the token covers       */
+/*         tokenBytes, set to the size of the token in bytes                 */
+/*         resync, set non-zero if the encoder is in its initial state after */
+/*                 the token                                                 */
+/* Returns: 0 on success, -1 if the token is truncated.                      */
+/*****************************************************************************/
+int incr_parse_token(char* pToken, size_t bytesLeft, int cmprType,
+					 size_t* numUnits, size_t* tokenBytes, int* resync)
+{
+	size_t unitSize = cmp_unit_size(cmprType);
+	long long count;
+
+	if(bytesLeft < unitSize)
+		return -1;
+
+	/* Counts are stored swapped the same way the kernels store them */
+	switch(cmprType){
+		case SHORT_CMP_TYPE:
+		{
+			short sCount;
+			memcpy(&sCount,pToken,2);
+			swap16(&sCount);
+			count = sCount;
+			*resync = (count == MIN_S_SHORT);
+		}
+		break;
+
+		case LONG_CMP_TYPE:
+		{
+			int lCount;
+			memcpy(&lCount,pToken,4);
+			swap32(&lCount);
+			count = lCount;
+			*resync = (count == MIN_S_LONG);
+		}
+		break;
+
+		default:
+			count = (signed char)pToken[0];
+			*resync = (count == MIN_S_BYTE);
+	}
+
+	/* Run: (Length-2), then the pattern */
+	if(count >= 0){
+		*numUnits = (size_t)count + 2;
+		*tokenBytes = 2*unitSize;
+		*resync = 1;
+	}
+
+	/* Literal: negative length, then the data */
+	else{
+		*numUnits = (size_t)(-count);
+		*tokenBytes = (1 + *numUnits)*unitSize;
+	}
+	if(*tokenBytes > bytesLeft)
+		return -1;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_addPoint - Appends a point, ignoring points that do not advance.     */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int incr_addPoint(incrPointList* list, unsigned long long unitOffset,
+						 unsigned long long outOffset)
+{
+	incrPoint* tmp;
+
+	if((list->count > 0) && (list->pts[list->count-1].unitOffset >= unitOffset))
+		return 0;
+	if(list->count == list->maxCount){
+		list->maxCount = (list->maxCount == 0) ? 256 : list->maxCount*2;
+		tmp = (incrPoint*)realloc(list->pts,list->maxCount*sizeof(incrPoint));
+		if(tmp == NULL){
+			printf("Error allocating memory for index points\n");
+			return -1;
+		}
+		list->pts = tmp;
+	}
+	list->pts[list->count].unitOffset = unitOffset;
+	list->pts[list->count].outOffset = outOffset;
+	list->count++;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_findPoint - Finds the last point at or before a unit offset.         */
+/* Returns: index of the point (points[0] is always unit 0).                 */
+/*****************************************************************************/
+static size_t incr_findPoint(incrPoint* points, size_t numPoints,
+							 unsigned long long unitOffset)
+{
+	size_t lo = 0;
+	size_t hi = numPoints;
+
+	while((hi - lo) > 1){
+		size_t mid = lo + (hi - lo)/2;
+		if(points[mid].unitOffset <= unitOffset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_build_index - Records a sparse set of resync points in a stream.     */
+/* Inputs: pCmprData/cmprSizeBytes, compressed stream (no header)            */
+/*         cmprType, BYTE_CMP_TYPE, SHORT_CMP_TYPE or LONG_CMP_TYPE          */
+/*         spacingUnits, minimum input units between recorded points         */
+/*         pPoints/numPoints, set to the malloced points                     */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int incr_build_index(char* pCmprData, size_t cmprSizeBytes, int cmprType,
+					 size_t spacingUnits, incrPoint** pPoints, size_t* numPoints)
+{
+	incrPointList list;
+	size_t outPos, unitPos, tokUnits, tokBytes;
+	int resync;
+
+	memset(&list,0,sizeof(list));
+	*pPoints = NULL;
+	*numPoints = 0;
+
+	if(incr_addPoint(&list,0,0) < 0)
+		return -1;
+	outPos = unitPos = 0;
+	while(outPos < cmprSizeBytes){
+		if(incr_parse_token(pCmprData + outPos,cmprSizeBytes - outPos,cmprType,
+			&tokUnits,&tokBytes,&resync) < 0){
+			printf("Error, compressed stream is truncated\n");
+			free(list.pts);
+			return -1;
+		}
+		outPos += tokBytes;
+		unitPos += tokUnits;
+		if(resync &&
+			((unitPos - list.pts[list.count-1].unitOffset) >= spacingUnits)){
+			if(incr_addPoint(&list,unitPos,outPos) < 0){
+				free(list.pts);
+				return -1;
+			}
+		}
+	}
+	*pPoints = list.pts;
+	*numPoints = list.count;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_free_edits - Releases a list of stream edits.                        */
+/*****************************************************************************/
+void incr_free_edits(incrEdit* edits, size_t numEdits){
+
+	size_t x;
+
+	if(edits == NULL)
+		return;
+	for(x = 0; x < numEdits; x++)
+		free(edits[x].pNewData);
+	free(edits);
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_splice - Re-encodes the tokens around changed ranges of an input.    */
+/* Inputs: pNewData/sizeBytes, the edited input, same size as the old input  */
+/*         cmprType, BYTE_CMP_TYPE, SHORT_CMP_TYPE or LONG_CMP_TYPE          */
+/*         oldCmprSizeBytes, size of the old compressed stream               */
+/*         oldPoints/numOldPoints, resync points of the old stream           */
+/*         ranges/numRanges, sorted, disjoint changed ranges in units        */
+/*         spacingUnits, minimum units between points in the new index       */
+/*         windowUnits, initial size of each re-encode window                */
+/*         pEdits/numEdits, set to the replacements for the old stream, in   */
+/*                          stream order                                     */
+/*         pNewPoints/numNewPoints, set to the resync points of the new      */
+/*                                  stream                                   */
+/*         reencodedUnits, set to the number of input units encoded          */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int incr_splice(char* pNewData, size_t sizeBytes, int cmprType,
+				size_t oldCmprSizeBytes, incrPoint* oldPoints, size_t numOldPoints,
+				incrRange* ranges, size_t numRanges,
+				size_t spacingUnits, size_t windowUnits,
+				incrEdit** pEdits, size_t* numEdits,
+				incrPoint** pNewPoints, size_t* numNewPoints,
+				size_t* reencodedUnits)
+{
+	incrPointList newList;
+	incrEdit* edits = NULL;
+	incrEdit* tmpEdits;
+	char* editBuf = NULL;
+	char* pCmprBuf;
+	size_t unitSize, numUnits, ri, oi, x;
+	size_t prevUnit, prevOut, cursor, cursorOut, endUnit;
+	size_t editLen, editMax, pos, winUnits, winEnd, winBytes, cmprSizeBytes;
+	size_t tokPos, tokOut, tokUnits, tokBytes, resyncUnit, resyncLen;
+	long long outDelta;
+	int resync, converged, atEnd, rval;
+
+	memset(&newList,0,sizeof(newList));
+	*pEdits = NULL;
+	*numEdits = 0;
+	*pNewPoints = NULL;
+	*numNewPoints = 0;
+	*reencodedUnits = 0;
+	unitSize = cmp_unit_size(cmprType);
+	numUnits = (sizeBytes + unitSize - 1) / unitSize;
+	if(windowUnits < 2*CMP_LOOKAHEAD_UNITS)
+		windowUnits = 2*CMP_LOOKAHEAD_UNITS;
+
+	rval = 0;
+	outDelta = 0;
+	prevUnit = prevOut = 0;
+	oi = 0;
+	ri = 0;
+	while((ri < numRanges) && (rval == 0)){
+
+		/* Start at the last old point the first change cannot affect */
+		endUnit = ranges[ri].endUnit;
+		if(ranges[ri].startUnit >= CMP_LOOKAHEAD_UNITS)
+			x = incr_findPoint(oldPoints,numOldPoints,
+				ranges[ri].startUnit - CMP_LOOKAHEAD_UNITS);
+		else
+			x = 0;
+		ri++;
+		cursor = prevUnit;
+		cursorOut = prevOut;
+		if(oldPoints[x].unitOffset > prevUnit){
+			cursor = (size_t)oldPoints[x].unitOffset;
+			cursorOut = (size_t)oldPoints[x].outOffset;
+		}
+
+		/* Old points up to the start are kept, shifted by earlier edits */
+		for(; (oi < numOldPoints) && (oldPoints[oi].unitOffset <= cursor); oi++){
+			if(incr_addPoint(&newList,oldPoints[oi].unitOffset,
+				oldPoints[oi].outOffset + outDelta) < 0)
+				rval = -1;
+		}
+		if(incr_addPoint(&newList,cursor,cursorOut + outDelta) < 0)
+			rval = -1;
+
+		/* Re-encode windows until the new stream rejoins the old one */
+		editLen = editMax = 0;
+		pos = cursor;
+		winUnits = windowUnits;
+		converged = atEnd = 0;
+		while(!converged && (rval == 0)){
+
+			winEnd = ((numUnits - pos) > winUnits) ? (pos + winUnits) : numUnits;
+			winBytes = (winEnd == numUnits) ? (sizeBytes - pos*unitSize) :
+				((winEnd - pos)*unitSize);
+			if(cmp_encode(pNewData + pos*unitSize,winBytes,cmprType,
+				&pCmprBuf,&cmprSizeBytes) < 0){
+				rval = -1;
+				break;
+			}
+			*reencodedUnits += winEnd - pos;
+
+			/* Make room for the whole window in the edit buffer */
+			if((editLen + cmprSizeBytes) > editMax){
+				char* tmp;
+				editMax = 2*(editLen + cmprSizeBytes);
+				tmp = (char*)realloc(editBuf,editMax);
+				if(tmp == NULL){
+					printf("Error allocating memory for stream edit\n");
+					free(pCmprBuf);
+					rval = -1;
+					break;
+				}
+				editBuf = tmp;
+			}
+
+			/* Keep the tokens the window encoded exactly */
+			tokPos = pos;
+			tokOut = 0;
+			resyncUnit = pos;
+			resyncLen = editLen;
+			while(tokOut < cmprSizeBytes){
+				if(incr_parse_token(pCmprBuf + CMP_MAX_HDR_BYTES + tokOut,
+					cmprSizeBytes - tokOut,cmprType,&tokUnits,&tokBytes,&resync) < 0){
+					rval = -1;
+					break;
+				}
+				if((winEnd < numUnits) && ((tokPos + tokUnits) > (winEnd - CMP_LOOKAHEAD_UNITS)))
+					break;
+				memcpy(editBuf + editLen,pCmprBuf + CMP_MAX_HDR_BYTES + tokOut,tokBytes);
+				editLen += tokBytes;
+				tokOut += tokBytes;
+				tokPos += tokUnits;
+				if(!resync)
+					continue;
+				resyncUnit = tokPos;
+				resyncLen = editLen;
+
+				/* Changes that the tokens so far can see join this edit */
+				while((ri < numRanges) &&
+					(ranges[ri].startUnit < (tokPos + CMP_LOOKAHEAD_UNITS))){
+					if(ranges[ri].endUnit > endUnit)
+						endUnit = ranges[ri].endUnit;
+					ri++;
+				}
+
+				/* Rejoin the old stream at a point it shares */
+				if(tokPos >= endUnit){
+					while((oi < numOldPoints) && (oldPoints[oi].unitOffset < tokPos))
+						oi++;
+					if((oi < numOldPoints) && (oldPoints[oi].unitOffset == tokPos)){
+						converged = 1;
+						break;
+					}
+				}
+				if((tokPos - newList.pts[newList.count-1].unitOffset) >= spacingUnits){
+					if(incr_addPoint(&newList,tokPos,cursorOut + outDelta + editLen) < 0){
+						rval = -1;
+						break;
+					}
+				}
+			}
+			free(pCmprBuf);
+			if(converged || (rval < 0))
+				break;
+
+			/* Reached the end of the input, the rest of the old stream goes */
+			if(winEnd == numUnits){
+				atEnd = 1;
+				break;
+			}
+
+			/* Continue from the last resync point, widening if none was found */
+			editLen = resyncLen;
+			if(resyncUnit == pos)
+				winUnits *= 2;
+			pos = resyncUnit;
+		}
+		if(rval < 0)
+			break;
+
+		/* Record the edit */
+		tmpEdits = (incrEdit*)realloc(edits,(*numEdits + 1)*sizeof(incrEdit));
+		if(tmpEdits == NULL){
+			printf("Error allocating memory for stream edit\n");
+			rval = -1;
+			break;
+		}
+		edits = tmpEdits;
+		edits[*numEdits].oldStart = cursorOut;
+		edits[*numEdits].oldEnd = atEnd ? oldCmprSizeBytes :
+			(size_t)oldPoints[oi].outOffset;
+		edits[*numEdits].newSizeBytes = editLen;
+		edits[*numEdits].pNewData = editBuf;
+		editBuf = NULL;
+		(*numEdits)++;
+
+		/* Shift the rest of the old stream by the size change */
+		outDelta += (long long)editLen -
+			(long long)(edits[*numEdits-1].oldEnd - edits[*numEdits-1].oldStart);
+		if(atEnd){
+			oi = numOldPoints;
+			ri = numRanges;
+		}
+		else{
+			prevUnit = (size_t)oldPoints[oi].unitOffset;
+			prevOut = (size_t)oldPoints[oi].outOffset;
+		}
+	}
+
+	/* Remaining old points are kept */
+	for(; (oi < numOldPoints) && (rval == 0); oi++){
+		if(incr_addPoint(&newList,oldPoints[oi].unitOffset,
+			oldPoints[oi].outOffset + outDelta) < 0)
+			rval = -1;
+	}
+
+	/* Free Resources */
+	free(editBuf);
+	if(rval < 0){
+		incr_free_edits(edits,*numEdits);
+		*numEdits = 0;
+		free(newList.pts);
+		return -1;
+	}
+	*pEdits = edits;
+	*pNewPoints = newList.pts;
+	*numNewPoints = newList.count;
+
+	return 0;
+}
+
+
+
+
+#ifndef _WIN32
+
+/*****************************************************************************/
+/* incr_hashBlock - FNV-1a hash of one input block.                          */
+/*****************************************************************************/
+static unsigned long long incr_hashBlock(char* pData, size_t numBytes){
+
+	unsigned long long hash = INCR_FNV_OFFSET;
+	size_t x;
+
+	for(x = 0; x < numBytes; x++){
+		hash ^= (unsigned char)pData[x];
+		hash *= INCR_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_loadIndex - Reads a sidecar index.                                   */
+/* Returns: 0 on success, -1 if missing or unreadable.                       */
+/*****************************************************************************/
+static int incr_loadIndex(char* idxFname, incrIdxHdr* pHdr,
+						  unsigned long long** pHashes, incrPoint** pPoints)
+{
+	FILE* ifile;
+	int rval = 0;
+
+	*pHashes = NULL;
+	*pPoints = NULL;
+	ifile = fopen(idxFname,"rb");
+	if(ifile == NULL)
+		return -1;
+	if((fread(pHdr,sizeof(incrIdxHdr),1,ifile) != 1) ||
+		(pHdr->magic != INCR_MAGIC) || (pHdr->version != INCR_VERSION) ||
+		(pHdr->numPoints == 0) ||
+		(pHdr->numBlocks > (CMP_MAX_INPUT_BYTES / sizeof(unsigned long long))) ||
+		(pHdr->numPoints > (CMP_MAX_INPUT_BYTES / sizeof(incrPoint)))){
+		fclose(ifile);
+		return -1;
+	}
+
+	*pHashes = (unsigned long long*)malloc((size_t)pHdr->numBlocks*
+		sizeof(unsigned long long) + 1);
+	*pPoints = (incrPoint*)malloc((size_t)pHdr->numPoints*sizeof(incrPoint));
+	if((*pHashes == NULL) || (*pPoints == NULL) ||
+		(fread(*pHashes,sizeof(unsigned long long),(size_t)pHdr->numBlocks,ifile) !=
+		(size_t)pHdr->numBlocks) ||
+		(fread(*pPoints,sizeof(incrPoint),(size_t)pHdr->numPoints,ifile) !=
+		(size_t)pHdr->numPoints)){
+		free(*pHashes);
+		free(*pPoints);
+		*pHashes = NULL;
+		*pPoints = NULL;
+		rval = -1;
+	}
+	fclose(ifile);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_writeIndex - Writes a sidecar index for a freshly written output.    */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int incr_writeIndex(char* idxFname, char* outputFname, incrIdxHdr* pHdr,
+						   unsigned long long* hashes, incrPoint* points)
+{
+	FILE* ifile;
+	struct stat st;
+	int rval = 0;
+
+	/* Tie the index to this exact output file */
+	if(stat(outputFname,&st) != 0){
+		printf("Error reading status of %s\n",outputFname);
+		return -1;
+	}
+	pHdr->magic = INCR_MAGIC;
+	pHdr->version = INCR_VERSION;
+	pHdr->mtimeSec = (unsigned long long)st.st_mtime;
+	pHdr->mtimeNsec = (unsigned long long)cmp_mtime_nsec(&st);
+	pHdr->blockBytes = INCR_BLOCK_BYTES;
+
+	ifile = fopen(idxFname,"wb");
+	if(ifile == NULL){
+		printf("Error opening index %s\n",idxFname);
+		return -1;
+	}
+	if((fwrite(pHdr,sizeof(incrIdxHdr),1,ifile) != 1) ||
+		(fwrite(hashes,sizeof(unsigned long long),(size_t)pHdr->numBlocks,ifile) !=
+		(size_t)pHdr->numBlocks) ||
+		(fwrite(points,sizeof(incrPoint),(size_t)pHdr->numPoints,ifile) !=
+		(size_t)pHdr->numPoints)){
+		printf("Error writing index %s\n",idxFname);
+		rval = -1;
+	}
+	if(fclose(ifile) != 0)
+		rval = -1;
+
+	/* A partial index must not be trusted on the next run */
+	if(rval < 0)
+		remove(idxFname);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_full - Compresses the whole input and writes a fresh index.          */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int incr_full(cmpInput* pInput, char* outputFname, char* idxFname,
+					 incrIdxHdr* pHdr, unsigned long long* hashes)
+{
+	char* pCmprBuf, *pOut;
+	incrPoint* points;
+	size_t cmprSizeBytes, numPoints;
+	int hdrSizeBytes, rval;
+
+	if(cmp_encode(pInput->pData,pInput->sizeBytes,(int)pHdr->cmprType,
+		&pCmprBuf,&cmprSizeBytes) < 0){
+		printf("Error encountered during compression.\n");
+		return -1;
+	}
+	pOut = cmp_prepend_header(pCmprBuf,(int)pHdr->cmprType,pInput->sizeBytes,
+		(int)pHdr->forceHdrSize32,&hdrSizeBytes);
+	if(pOut == NULL){
+		free(pCmprBuf);
+		return -1;
+	}
+	if(cmp_write_output(outputFname,pOut,hdrSizeBytes + cmprSizeBytes) < 0){
+		free(pCmprBuf);
+		return -1;
+	}
+
+	/* Index the new stream */
+	rval = incr_build_index(pCmprBuf + CMP_MAX_HDR_BYTES,cmprSizeBytes,
+		(int)pHdr->cmprType,INCR_POINT_SPACING / cmp_unit_size((int)pHdr->cmprType),
+		&points,&numPoints);
+	free(pCmprBuf);
+	if(rval < 0)
+		return -1;
+	pHdr->cmprSizeBytes = cmprSizeBytes;
+	pHdr->hdrSizeBytes = hdrSizeBytes;
+	pHdr->numPoints = numPoints;
+	rval = incr_writeIndex(idxFname,outputFname,pHdr,hashes,points);
+	free(points);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_apply_edits - Splices re-encoded tokens into the existing output.    */
+/*                    If every edit keeps its own size they are written in   */
+/*                    place, otherwise the output is rebuilt in a temporary  */
+/*                    file and renamed over the old one.                     */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int incr_apply_edits(char* outputFname, size_t hdrSizeBytes,
+					 size_t oldCmprSizeBytes, size_t newCmprSizeBytes,
+					 incrEdit* edits, size_t numEdits)
+{
+	static char tmpFname[310];
+	char* pOld, *pNew;
+	size_t oldPos, newPos, x;
+	FILE* ofile;
+	int fd, inPlace, rval = 0;
+
+	/* Equal totals are not enough, one edit may grow as another shrinks */
+	inPlace = 1;
+	for(x = 0; x < numEdits; x++){
+		if(edits[x].newSizeBytes != (edits[x].oldEnd - edits[x].oldStart))
+			inPlace = 0;
+	}
+
+	/* Overwrite the edited ranges */
+	if(inPlace){
+		fd = open(outputFname,O_WRONLY);
+		if(fd < 0){
+			printf("Error opening %s\n",outputFname);
+			return -1;
+		}
+		for(x = 0; x < numEdits; x++){
+			if(pwrite(fd,edits[x].pNewData,edits[x].newSizeBytes,
+				(off_t)(hdrSizeBytes + edits[x].oldStart)) !=
+				(ssize_t)edits[x].newSizeBytes){
+				printf("Error writing %s\n",outputFname);
+				rval = -1;
+				break;
+			}
+		}
+		if(close(fd) != 0)
+			rval = -1;
+		return rval;
+	}
+
+	/* Read the old output */
+	pOld = (char*)malloc(hdrSizeBytes + oldCmprSizeBytes + 1);
+	pNew = (char*)malloc(hdrSizeBytes + newCmprSizeBytes + 1);
+	ofile = fopen(outputFname,"rb");
+	if((pOld == NULL) || (pNew == NULL) || (ofile == NULL)){
+		printf("Error reading %s\n",outputFname);
+		if(ofile != NULL)
+			fclose(ofile);
+		free(pOld);
+		free(pNew);
+		return -1;
+	}
+	if(fread(pOld,1,hdrSizeBytes + oldCmprSizeBytes,ofile) !=
+		(hdrSizeBytes + oldCmprSizeBytes)){
+		printf("Error reading %s\n",outputFname);
+		rval = -1;
+	}
+	fclose(ofile);
+
+	/* Header is unchanged, then old segments between the edits */
+	if(rval == 0){
+		memcpy(pNew,pOld,hdrSizeBytes);
+		oldPos = 0;
+		newPos = hdrSizeBytes;
+		for(x = 0; x < numEdits; x++){
+			memcpy(pNew + newPos,pOld + hdrSizeBytes + oldPos,
+				edits[x].oldStart - oldPos);
+			newPos += edits[x].oldStart - oldPos;
+			memcpy(pNew + newPos,edits[x].pNewData,edits[x].newSizeBytes);
+			newPos += edits[x].newSizeBytes;
+			oldPos = edits[x].oldEnd;
+		}
+		memcpy(pNew + newPos,pOld + hdrSizeBytes + oldPos,oldCmprSizeBytes - oldPos);
+
+		/* Replace the output atomically */
+		snprintf(tmpFname,sizeof(tmpFname),"%s.tmp",outputFname);
+		if(cmp_write_output(tmpFname,pNew,hdrSizeBytes + newCmprSizeBytes) < 0)
+			rval = -1;
+		else if(rename(tmpFname,outputFname) != 0){
+			printf("Error replacing %s\n",outputFname);
+			remove(tmpFname);
+			rval = -1;
+		}
+	}
+	free(pOld);
+	free(pNew);
+
+	return rval;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_compress - Compresses a file, re-encoding only the changed parts of  */
+/*                 the input when a matching sidecar index exists.           */
+/* Inputs: inputFname/outputFname, as for a full compress                    */
+/*         fileOffset/reqDataSizeBytes/cmprType/forceHdrSize32, as for a     */
+/*         full compress                                                     */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int incr_compress(char* inputFname, char* outputFname, off_t fileOffset,
+				  size_t reqDataSizeBytes, int cmprType, int forceHdrSize32)
+{
+	static char idxFname[310];
+	cmpInput input;
+	incrIdxHdr hdr, oldHdr;
+	unsigned long long* hashes, *oldHashes;
+	incrPoint* oldPoints, *newPoints;
+	incrRange* ranges;
+	incrEdit* edits;
+	struct stat st;
+	size_t unitSize, numBlocks, numRanges, numEdits, numNewPoints;
+	size_t blockEnd, reencodedUnits, newCmprSizeBytes, x;
+	int rval;
+
+	snprintf(idxFname,sizeof(idxFname),"%s%s",outputFname,INCR_SIDECAR_EXT);
+	unitSize = cmp_unit_size(cmprType);
+
+	/* Read and hash the input */
+	if(cmp_read_input(inputFname,fileOffset,reqDataSizeBytes,&input) < 0)
+		return -1;
+	numBlocks = (input.sizeBytes + INCR_BLOCK_BYTES - 1) / INCR_BLOCK_BYTES;
+	hashes = (unsigned long long*)malloc(numBlocks*sizeof(unsigned long long) + 1);
+	if(hashes == NULL){
+		printf("Error allocating memory for block hashes\n");
+		cmp_free_input(&input);
+		return -1;
+	}
+	for(x = 0; x < numBlocks; x++){
+		blockEnd = (x + 1)*INCR_BLOCK_BYTES;
+		if(blockEnd > input.sizeBytes)
+			blockEnd = input.sizeBytes;
+		hashes[x] = incr_hashBlock(input.pData + x*INCR_BLOCK_BYTES,
+			blockEnd - x*INCR_BLOCK_BYTES);
+	}
+	memset(&hdr,0,sizeof(hdr));
+	hdr.cmprType = cmprType;
+	hdr.forceHdrSize32 = forceHdrSize32;
+	hdr.fileOffset = (unsigned long long)fileOffset;
+	hdr.reqSizeBytes = reqDataSizeBytes;
+	hdr.inputSizeBytes = input.sizeBytes;
+	hdr.numBlocks = numBlocks;
+
+	/* Use the index only if it describes this exact output and layout */
+	if((incr_loadIndex(idxFname,&oldHdr,&oldHashes,&oldPoints) < 0) ||
+		(stat(outputFname,&st) != 0) ||
+		(oldHdr.cmprType != hdr.cmprType) ||
+		(oldHdr.forceHdrSize32 != hdr.forceHdrSize32) ||
+		(oldHdr.fileOffset != hdr.fileOffset) ||
+		(oldHdr.reqSizeBytes != hdr.reqSizeBytes) ||
+		(oldHdr.inputSizeBytes != hdr.inputSizeBytes) ||
+		(oldHdr.blockBytes != INCR_BLOCK_BYTES) ||
+		(oldHdr.numBlocks != hdr.numBlocks) ||
+		((unsigned long long)st.st_size != (oldHdr.hdrSizeBytes + oldHdr.cmprSizeBytes)) ||
+		((unsigned long long)st.st_mtime != oldHdr.mtimeSec) ||
+		((unsigned long long)cmp_mtime_nsec(&st) != oldHdr.mtimeNsec)){
+		printf("No usable index for %s, compressing the whole input\n",outputFname);
+		free(oldHashes);
+		free(oldPoints);
+		rval = incr_full(&input,outputFname,idxFname,&hdr,hashes);
+		free(hashes);
+		cmp_free_input(&input);
+		return rval;
+	}
+
+	/* Changed blocks, merged into ranges of units */
+	ranges = (incrRange*)malloc((numBlocks + 1)*sizeof(incrRange));
+	if(ranges == NULL){
+		printf("Error allocating memory for changed ranges\n");
+		free(oldHashes);
+		free(oldPoints);
+		free(hashes);
+		cmp_free_input(&input);
+		return -1;
+	}
+	numRanges = 0;
+	for(x = 0; x < numBlocks; x++){
+		if(hashes[x] == oldHashes[x])
+			continue;
+		blockEnd = (x + 1)*INCR_BLOCK_BYTES;
+		if(blockEnd > input.sizeBytes)
+			blockEnd = input.sizeBytes;
+		if((numRanges > 0) &&
+			(ranges[numRanges-1].endUnit == (x*INCR_BLOCK_BYTES) / unitSize)){
+			ranges[numRanges-1].endUnit = (blockEnd + unitSize - 1) / unitSize;
+		}
+		else{
+			ranges[numRanges].startUnit = (x*INCR_BLOCK_BYTES) / unitSize;
+			ranges[numRanges].endUnit = (blockEnd + unitSize - 1) / unitSize;
+			numRanges++;
+		}
+	}
+	free(oldHashes);
+	if(numRanges == 0){
+		printf("%s is up to date\n",outputFname);
+		free(ranges);
+		free(oldPoints);
+		free(hashes);
+		cmp_free_input(&input);
+		return 0;
+	}
+
+	/* Re-encode around the changes and splice into the old stream */
+	rval = incr_splice(input.pData,input.sizeBytes,cmprType,
+		(size_t)oldHdr.cmprSizeBytes,oldPoints,(size_t)oldHdr.numPoints,
+		ranges,numRanges,INCR_POINT_SPACING / unitSize,INCR_WINDOW_BYTES / unitSize,
+		&edits,&numEdits,&newPoints,&numNewPoints,&reencodedUnits);
+	free(ranges);
+	free(oldPoints);
+	cmp_free_input(&input);
+	if(rval < 0){
+		free(hashes);
+		return -1;
+	}
+	newCmprSizeBytes = (size_t)oldHdr.cmprSizeBytes;
+	for(x = 0; x < numEdits; x++)
+		newCmprSizeBytes += edits[x].newSizeBytes - (edits[x].oldEnd - edits[x].oldStart);
+	rval = incr_apply_edits(outputFname,(size_t)oldHdr.hdrSizeBytes,
+		(size_t)oldHdr.cmprSizeBytes,newCmprSizeBytes,edits,numEdits);
+	incr_free_edits(edits,numEdits);
+
+	/* Index the updated output */
+	if(rval == 0){
+		printf("Incremental: %llu of %llu bytes re-encoded, %lu edit(s), "
+			"stream %llu -> %llu bytes\n",
+			(unsigned long long)reencodedUnits*unitSize,hdr.inputSizeBytes,
+			(unsigned long)numEdits,oldHdr.cmprSizeBytes,
+			(unsigned long long)newCmprSizeBytes);
+		hdr.cmprSizeBytes = newCmprSizeBytes;
+		hdr.hdrSizeBytes = oldHdr.hdrSizeBytes;
+		hdr.numPoints = numNewPoints;
+		rval = incr_writeIndex(idxFname,outputFname,&hdr,hashes,newPoints);
+	}
+	else
+		remove(idxFname);
+	free(newPoints);
+	free(hashes);
+
+	return rval;
+}
+
+#else
+
+/*****************************************************************************/
+/* incr_compress - Incremental mode needs POSIX file I/O.                    */
+/*****************************************************************************/
+int incr_compress(char* inputFname, char* outputFname, off_t fileOffset,
+				  size_t reqDataSizeBytes, int cmprType, int forceHdrSize32)
+{
+	(void)inputFname; (void)outputFname; (void)fileOffset;
+	(void)reqDataSizeBytes; (void)cmprType; (void)forceHdrSize32;
+	printf("Error, incremental mode is not supported on this platform\n");
+	return -1;
+}
+
+
+
+
+/*****************************************************************************/
+/* incr_apply_edits - Incremental mode needs POSIX file I/O.                 */
+/*****************************************************************************/
+int incr_apply_edits(char* outputFname, size_t hdrSizeBytes,
+					 size_t oldCmprSizeBytes, size_t newCmprSizeBytes,
+					 incrEdit* edits, size_t numEdits)
+{
+	(void)outputFname; (void)hdrSizeBytes; (void)oldCmprSizeBytes;
+	(void)newCmprSizeBytes; (void)edits; (void)numEdits;
+	printf("Error, incremental mode is not supported on this platform\n");
+	return -1;
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*****************************************************************************/
+/* incremental.h - Incremental re-encoding by token stream splicing.         */
+/*****************************************************************************/
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//Defines
+#define INCR_SIDECAR_EXT       ".idx"
+#define INCR_BLOCK_BYTES       4096    //Input bytes covered by each block hash
+#define INCR_POINT_SPACING     4096    //Min input bytes between index points
+#define INCR_WINDOW_BYTES      16384   //Initial re-encode window
+
+//Resync point, where the encoder is in its initial state
+typedef struct{
+	unsigned long long unitOffset;   //Input offset in pattern units
+	unsigned long long outOffset;    //Compressed stream offset in bytes
+}incrPoint;
+
+//Changed input range, in pattern units [startUnit, endUnit)
+typedef struct{
+	size_t startUnit;
+	size_t endUnit;
+}incrRange;
+
+//Replacement of part of the old compressed stream
+typedef struct{
+	size_t oldStart;         //Replaced range of the old stream [oldStart, oldEnd)
+	size_t oldEnd;
+	char*  pNewData;         //Replacement bytes (malloced)
+	size_t newSizeBytes;
+}incrEdit;
+
+//Fctn Prototypes
+int incr_parse_token(char* pToken, size_t bytesLeft, int cmprType,
+					 size_t* numUnits, size_t* tokenBytes, int* resync);
+int incr_build_index(char* pCmprData, size_t cmprSizeBytes, int cmprType,
+					 size_t spacingUnits, incrPoint** pPoints, size_t* numPoints);
+int incr_splice(char* pNewData, size_t sizeBytes, int cmprType,
+				size_t oldCmprSizeBytes, incrPoint* oldPoints, size_t numOldPoints,
+				incrRange* ranges, size_t numRanges,
+				size_t spacingUnits, size_t windowUnits,
+				incrEdit** pEdits, size_t* numEdits,
+				incrPoint** pNewPoints, size_t* numNewPoints,
+				size_t* reencodedUnits);
+void incr_free_edits(incrEdit* edits, size_t numEdits);
+int incr_apply_edits(char* outputFname, size_t hdrSizeBytes,
+					 size_t oldCmprSizeBytes, size_t newCmprSizeBytes,
+					 incrEdit* edits, size_t numEdits);
+int incr_compress(char* inputFname, char* outputFname, off_t fileOffset,
+				  size_t reqDataSizeBytes, int cmprType, int forceHdrSize32);
+
+#endif
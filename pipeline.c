@@ -0,0 +1,389 @@
+/*****************************************************************************/
+/* pipeline.c - Overlapped read / compress / write pipeline for batches.     */
+/*              A reader thread prefetches inputs and a writer thread writes */
+/*              finished outputs while the calling thread compresses.  The   */
+/*              stages are connected by bounded queues, so at most           */
+/*              queueDepth jobs wait between any two stages.  Overlap is     */
+/*              between files, so a single input gains nothing, as the       */
+/*              encoder takes the whole input as one buffer.                 */
+/*****************************************************************************/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "compress_rtns.h"
+#include "pipeline.h"
+
+/* Defines */
+#define PIPE_STAGE_READ    0
+#define PIPE_STAGE_ENCODE  1
+#define PIPE_STAGE_WRITE   2
+#define PIPE_NUM_STAGES    3
+
+/* A single job as it moves through the pipeline */
+typedef struct{
+	int   jobIdx;
+	int   err;
+	cmpInput input;
+	char* pCmprBuf;
+	char* pOut;
+	size_t cmprSizeBytes;
+	int   hdrSizeBytes;
+}pipeItem;
+
+/* Bounded FIFO connecting two stages */
+typedef struct{
+	pipeItem**      items;
+	int             depth;
+	int             head;
+	int             count;
+	int             closed;
+	pthread_mutex_t lock;
+	pthread_cond_t  notEmpty;
+	pthread_cond_t  notFull;
+}pipeQueue;
+
+/* State shared by all stages */
+typedef struct{
+	char**       inFnames;
+	char**       outFnames;
+	int          numJobs;
+	off_t        fileOffset;
+	size_t       dataSizeBytes;
+	int          cmprType;
+	int          forceHdrSize32;
+	pipeQueue    readQ;       /* reader -> encoder */
+	pipeQueue    writeQ;      /* encoder -> writer */
+	double       busyUs[PIPE_NUM_STAGES];
+	int          numErrors[PIPE_NUM_STAGES];
+	unsigned long long bytesIn;
+	unsigned long long bytesOut;
+}pipeCtx;
+
+static const char* pipe_stageNames[PIPE_NUM_STAGES] = {
+	"read", "encode", "write"
+};
+
+
+
+
+/*****************************************************************************/
+/* pipe_nowUs - Returns a monotonic timestamp in microseconds.               */
+/*****************************************************************************/
+static double pipe_nowUs(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (double)ts.tv_sec*1000000.0 + (double)ts.tv_nsec/1000.0;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_qInit - Initializes a bounded queue.                                 */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int pipe_qInit(pipeQueue* q, int depth){
+
+	memset(q,0,sizeof(*q));
+	q->items = (pipeItem**)malloc(depth*sizeof(pipeItem*));
+	if(q->items == NULL)
+		return -1;
+	q->depth = depth;
+	pthread_mutex_init(&q->lock,NULL);
+	pthread_cond_init(&q->notEmpty,NULL);
+	pthread_cond_init(&q->notFull,NULL);
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_qDestroy - Releases a bounded queue.                                 */
+/*****************************************************************************/
+static void pipe_qDestroy(pipeQueue* q){
+
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->notEmpty);
+	pthread_cond_destroy(&q->notFull);
+	free(q->items);
+	q->items = NULL;
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_qPush - Adds an item, blocking while the queue is full.              */
+/*****************************************************************************/
+static void pipe_qPush(pipeQueue* q, pipeItem* item){
+
+	pthread_mutex_lock(&q->lock);
+	while(q->count == q->depth)
+		pthread_cond_wait(&q->notFull,&q->lock);
+	q->items[(q->head + q->count) % q->depth] = item;
+	q->count++;
+	pthread_cond_signal(&q->notEmpty);
+	pthread_mutex_unlock(&q->lock);
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_qPop - Removes an item, blocking while the queue is empty.           */
+/* Returns: the item, or NULL once the queue is closed and drained.          */
+/*****************************************************************************/
+static pipeItem* pipe_qPop(pipeQueue* q){
+
+	pipeItem* item = NULL;
+
+	pthread_mutex_lock(&q->lock);
+	while((q->count == 0) && !q->closed)
+		pthread_cond_wait(&q->notEmpty,&q->lock);
+	if(q->count > 0){
+		item = q->items[q->head];
+		q->head = (q->head + 1) % q->depth;
+		q->count--;
+		pthread_cond_signal(&q->notFull);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return item;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_qClose - Marks that no more items will be pushed.                    */
+/*****************************************************************************/
+static void pipe_qClose(pipeQueue* q){
+
+	pthread_mutex_lock(&q->lock);
+	q->closed = 1;
+	pthread_cond_broadcast(&q->notEmpty);
+	pthread_mutex_unlock(&q->lock);
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_freeItem - Releases a job and its buffers.                           */
+/*****************************************************************************/
+static void pipe_freeItem(pipeItem* item){
+
+	if(item == NULL)
+		return;
+	cmp_free_input(&item->input);
+	free(item->pCmprBuf);
+	free(item);
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_reader - Reader stage, prefetches each input in job order.           */
+/*****************************************************************************/
+static void* pipe_reader(void* arg){
+
+	pipeCtx* ctx = (pipeCtx*)arg;
+	pipeItem* item;
+	double startUs;
+	int x;
+
+	for(x = 0; x < ctx->numJobs; x++){
+		startUs = pipe_nowUs();
+		item = (pipeItem*)calloc(1,sizeof(pipeItem));
+		if(item == NULL){
+			printf("Error allocating memory for pipeline job\n");
+			ctx->numErrors[PIPE_STAGE_READ]++;
+			continue;
+		}
+		item->jobIdx = x;
+		if(cmp_read_input(ctx->inFnames[x],ctx->fileOffset,ctx->dataSizeBytes,
+			&item->input) < 0){
+			item->err = 1;
+			ctx->numErrors[PIPE_STAGE_READ]++;
+		}
+		ctx->busyUs[PIPE_STAGE_READ] += pipe_nowUs() - startUs;
+		pipe_qPush(&ctx->readQ,item);
+	}
+	pipe_qClose(&ctx->readQ);
+
+	return NULL;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_writer - Writer stage, writes each finished output in job order.     */
+/*****************************************************************************/
+static void* pipe_writer(void* arg){
+
+	pipeCtx* ctx = (pipeCtx*)arg;
+	pipeItem* item;
+	double startUs;
+
+	while((item = pipe_qPop(&ctx->writeQ)) != NULL){
+		startUs = pipe_nowUs();
+		if(!item->err){
+			if(cmp_write_output(ctx->outFnames[item->jobIdx],item->pOut,
+				item->hdrSizeBytes + item->cmprSizeBytes) < 0){
+				printf("Error writing %s\n",ctx->outFnames[item->jobIdx]);
+				ctx->numErrors[PIPE_STAGE_WRITE]++;
+			}
+			else
+				ctx->bytesOut += item->hdrSizeBytes + item->cmprSizeBytes;
+		}
+		pipe_freeItem(item);
+		ctx->busyUs[PIPE_STAGE_WRITE] += pipe_nowUs() - startUs;
+	}
+
+	return NULL;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_report - Displays per-stage busy time.                               */
+/*****************************************************************************/
+static void pipe_report(pipeCtx* ctx, int queueDepth, double wallUs){
+
+	int x;
+
+	printf("Pipeline: %d files, %llu bytes in, %llu bytes out, queue depth %d\n",
+		ctx->numJobs,ctx->bytesIn,ctx->bytesOut,queueDepth);
+	printf("  %-8s %12s %8s\n","stage","busy(ms)","util%");
+	for(x = 0; x < PIPE_NUM_STAGES; x++){
+		printf("  %-8s %12.3f %8.1f\n",pipe_stageNames[x],
+			ctx->busyUs[x]/1000.0,
+			(wallUs > 0.0) ? 100.0*ctx->busyUs[x]/wallUs : 0.0);
+	}
+	printf("  %-8s %12.3f\n","wall",wallUs/1000.0);
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* pipe_run - Compresses a batch of files with overlapped I/O.               */
+/* Inputs: inFnames/outFnames, input and output filename for each job        */
+/*         numJobs, number of jobs                                           */
+/*         fileOffset/dataSizeBytes/cmprType/forceHdrSize32, as for a single */
+/*         file                                                              */
+/*         queueDepth, maximum jobs waiting between two stages               */
+/* Returns: 0 if every job succeeded, -1 otherwise.                          */
+/*****************************************************************************/
+int pipe_run(char** inFnames, char** outFnames, int numJobs,
+			 off_t fileOffset, size_t dataSizeBytes, int cmprType,
+			 int forceHdrSize32, int queueDepth)
+{
+	pipeCtx ctx;
+	pipeItem* item;
+	pthread_t readThread, writeThread;
+	double startUs, wallStartUs;
+	int numErrors, x;
+
+	memset(&ctx,0,sizeof(ctx));
+	ctx.inFnames = inFnames;
+	ctx.outFnames = outFnames;
+	ctx.numJobs = numJobs;
+	ctx.fileOffset = fileOffset;
+	ctx.dataSizeBytes = dataSizeBytes;
+	ctx.cmprType = cmprType;
+	ctx.forceHdrSize32 = forceHdrSize32;
+
+	if(pipe_qInit(&ctx.readQ,queueDepth) < 0){
+		printf("Error allocating pipeline queues\n");
+		return -1;
+	}
+	if(pipe_qInit(&ctx.writeQ,queueDepth) < 0){
+		printf("Error allocating pipeline queues\n");
+		pipe_qDestroy(&ctx.readQ);
+		return -1;
+	}
+
+	/* Start the reader and writer stages */
+	wallStartUs = pipe_nowUs();
+	if(pthread_create(&readThread,NULL,pipe_reader,&ctx) != 0){
+		printf("Error starting pipeline reader\n");
+		pipe_qDestroy(&ctx.readQ);
+		pipe_qDestroy(&ctx.writeQ);
+		return -1;
+	}
+	if(pthread_create(&writeThread,NULL,pipe_writer,&ctx) != 0){
+		printf("Error starting pipeline writer\n");
+		while((item = pipe_qPop(&ctx.readQ)) != NULL)
+			pipe_freeItem(item);
+		pthread_join(readThread,NULL);
+		pipe_qDestroy(&ctx.readQ);
+		pipe_qDestroy(&ctx.writeQ);
+		return -1;
+	}
+
+	/* Encoder stage runs on this thread */
+	while((item = pipe_qPop(&ctx.readQ)) != NULL){
+		startUs = pipe_nowUs();
+		if(!item->err){
+			ctx.bytesIn += item->input.sizeBytes;
+			if(cmp_encode(item->input.pData,item->input.sizeBytes,cmprType,
+				&item->pCmprBuf,&item->cmprSizeBytes) < 0){
+				printf("Error encountered during compression of %s\n",
+					inFnames[item->jobIdx]);
+				item->err = 1;
+				ctx.numErrors[PIPE_STAGE_ENCODE]++;
+			}
+			else{
+				item->pOut = cmp_prepend_header(item->pCmprBuf,cmprType,
+					item->input.sizeBytes,forceHdrSize32,&item->hdrSizeBytes);
+				if(item->pOut == NULL){
+					item->err = 1;
+					ctx.numErrors[PIPE_STAGE_ENCODE]++;
+				}
+			}
+		}
+
+		/* Input buffer is no longer needed once encoded */
+		cmp_free_input(&item->input);
+		ctx.busyUs[PIPE_STAGE_ENCODE] += pipe_nowUs() - startUs;
+		pipe_qPush(&ctx.writeQ,item);
+	}
+	pipe_qClose(&ctx.writeQ);
+
+	pthread_join(readThread,NULL);
+	pthread_join(writeThread,NULL);
+	pipe_qDestroy(&ctx.readQ);
+	pipe_qDestroy(&ctx.writeQ);
+
+	pipe_report(&ctx,queueDepth,pipe_nowUs() - wallStartUs);
+
+	numErrors = 0;
+	for(x = 0; x < PIPE_NUM_STAGES; x++)
+		numErrors += ctx.numErrors[x];
+	if(numErrors > 0){
+		printf("Error, %d of %d files failed\n",numErrors,numJobs);
+		return -1;
+	}
+
+	return 0;
+}
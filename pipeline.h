@@ -0,0 +1,18 @@
+/*****************************************************************************/
+/* pipeline.h - Overlapped read / compress / write pipeline for batches.     */
+/*****************************************************************************/
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//Defines
+#define PIPE_DEFAULT_DEPTH 2    //Jobs buffered between each pair of stages
+
+//Fctn Prototypes
+int pipe_run(char** inFnames, char** outFnames, int numJobs,
+			 off_t fileOffset, size_t dataSizeBytes, int cmprType,
+			 int forceHdrSize32, int queueDepth);
+
+#endif
@@ -0,0 +1,364 @@
+/*****************************************************************************/
+/* profile.c - Per-phase timing and hardware counter profiling.              */
+/*             On Linux, cycles/instructions/branch counters are sampled     */
+/*             with perf_event_open around each phase.  They are opened as   */
+/*             one group, so they are always scheduled together and counts   */
+/*             can be scaled when the PMU is multiplexed.  When the counters */
+/*             cannot be opened, only wall-clock time is reported.           */
+/*****************************************************************************/
+
+/* Includes */
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "profile.h"
+
+/* Defines */
+#define PROF_CTR_CYCLES    0
+#define PROF_CTR_INSTRS    1
+#define PROF_CTR_BRANCHES  2
+#define PROF_CTR_BRMISSES  3
+#define PROF_NUM_CTRS      4
+
+/* Accumulated statistics for a single phase */
+typedef struct{
+	double        wallUs;
+	unsigned long long ctr[PROF_NUM_CTRS];   /* Scaled to the enabled time */
+	unsigned long long enabledNs;            /* Counter group enabled time */
+	unsigned long long runningNs;            /* Time actually on the PMU   */
+}profPhase;
+
+/* Statistics for a file (or for the aggregate of all files) */
+typedef struct{
+	profPhase phase[PROF_NUM_PHASES];
+	unsigned long long numBytes;
+	int numFiles;
+}profStats;
+
+/* Globals */
+static int prof_on = 0;
+static int prof_hwCtrs = 0;
+static int prof_fd[PROF_NUM_CTRS] = {-1, -1, -1, -1};
+static double prof_startUs[PROF_NUM_PHASES];
+static unsigned long long prof_startCtr[PROF_NUM_PHASES][PROF_NUM_CTRS];
+static unsigned long long prof_startEnabled[PROF_NUM_PHASES];
+static unsigned long long prof_startRunning[PROF_NUM_PHASES];
+static profStats prof_file;
+static profStats prof_total;
+
+static const char* prof_phaseNames[PROF_NUM_PHASES] = {
+	"read", "encode", "header", "write"
+};
+
+
+
+
+/*****************************************************************************/
+/* prof_nowUs - Returns a monotonic timestamp in microseconds.               */
+/*****************************************************************************/
+static double prof_nowUs(){
+#if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (double)ts.tv_sec*1000000.0 + (double)ts.tv_nsec/1000.0;
+#else
+	return (double)clock()*1000000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_readCtrs - Reads every hardware counter with a single read of the    */
+/*                 group leader, along with the group's enabled and running  */
+/*                 times.                                                    */
+/*****************************************************************************/
+static void prof_readCtrs(unsigned long long* vals, unsigned long long* pEnabled,
+						  unsigned long long* pRunning){
+
+	/* | nr | time_enabled | time_running | value ... | */
+	unsigned long long buf[3 + PROF_NUM_CTRS];
+
+	memset(vals,0,sizeof(unsigned long long)*PROF_NUM_CTRS);
+	*pEnabled = *pRunning = 0;
+#ifdef __linux__
+	if(prof_hwCtrs && (read(prof_fd[PROF_CTR_CYCLES],buf,sizeof(buf)) == sizeof(buf)) &&
+		(buf[0] == PROF_NUM_CTRS)){
+		*pEnabled = buf[1];
+		*pRunning = buf[2];
+		memcpy(vals,&buf[3],sizeof(unsigned long long)*PROF_NUM_CTRS);
+	}
+#else
+	(void)buf;
+#endif
+	return;
+}
+
+
+
+
+#ifdef __linux__
+/*****************************************************************************/
+/* prof_openCtr - Opens a user-space hardware counter for this thread.       */
+/*                Pass groupFd -1 to open the group leader.                  */
+/* Returns: file descriptor on success, -1 on failure.                       */
+/*****************************************************************************/
+static int prof_openCtr(unsigned long long config, int groupFd){
+
+	struct perf_event_attr attr;
+	memset(&attr,0,sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+		PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(__NR_perf_event_open,&attr,0,-1,groupFd,0);
+}
+#endif
+
+
+
+
+/*****************************************************************************/
+/* prof_init - Enables profiling and opens the hardware counters.            */
+/* Returns: 1 if hardware counters are available, 0 if timers only.          */
+/*****************************************************************************/
+int prof_init(){
+
+	memset(&prof_file,0,sizeof(prof_file));
+	memset(&prof_total,0,sizeof(prof_total));
+	prof_hwCtrs = 0;
+
+#ifdef __linux__
+	/* Cycles leads the group, the rest are read along with it */
+	prof_fd[PROF_CTR_CYCLES]   = prof_openCtr(PERF_COUNT_HW_CPU_CYCLES,-1);
+	if(prof_fd[PROF_CTR_CYCLES] >= 0){
+		prof_fd[PROF_CTR_INSTRS]   = prof_openCtr(PERF_COUNT_HW_INSTRUCTIONS,
+			prof_fd[PROF_CTR_CYCLES]);
+		prof_fd[PROF_CTR_BRANCHES] = prof_openCtr(PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+			prof_fd[PROF_CTR_CYCLES]);
+		prof_fd[PROF_CTR_BRMISSES] = prof_openCtr(PERF_COUNT_HW_BRANCH_MISSES,
+			prof_fd[PROF_CTR_CYCLES]);
+	}
+	if( (prof_fd[PROF_CTR_CYCLES] >= 0) && (prof_fd[PROF_CTR_INSTRS] >= 0) &&
+		(prof_fd[PROF_CTR_BRANCHES] >= 0) && (prof_fd[PROF_CTR_BRMISSES] >= 0) )
+		prof_hwCtrs = 1;
+	else
+		prof_shutdown();
+#endif
+	prof_on = 1;
+
+	if(!prof_hwCtrs)
+		printf("Profile: hardware counters unavailable, reporting timers only\n");
+
+	return prof_hwCtrs;
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_shutdown - Closes any open hardware counters.                        */
+/*****************************************************************************/
+void prof_shutdown(){
+
+	int x;
+	for(x = 0; x < PROF_NUM_CTRS; x++){
+#ifdef __linux__
+		if(prof_fd[x] >= 0)
+			close(prof_fd[x]);
+#endif
+		prof_fd[x] = -1;
+	}
+	prof_hwCtrs = 0;
+	prof_on = 0;
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_enabled - Returns non-zero if profiling is active.                   */
+/*****************************************************************************/
+int prof_enabled(){
+	return prof_on;
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_begin - Marks the start of a phase.                                  */
+/*****************************************************************************/
+void prof_begin(int phase){
+
+	if(!prof_on || (phase < 0) || (phase >= PROF_NUM_PHASES))
+		return;
+
+	prof_readCtrs(prof_startCtr[phase],&prof_startEnabled[phase],
+		&prof_startRunning[phase]);
+	prof_startUs[phase] = prof_nowUs();
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_end - Marks the end of a phase, accumulating into the current file.  */
+/*****************************************************************************/
+void prof_end(int phase){
+
+	int x;
+	double endUs, scale;
+	unsigned long long endCtr[PROF_NUM_CTRS], enabled, running;
+	profPhase* p;
+
+	if(!prof_on || (phase < 0) || (phase >= PROF_NUM_PHASES))
+		return;
+
+	endUs = prof_nowUs();
+	prof_readCtrs(endCtr,&enabled,&running);
+	p = &prof_file.phase[phase];
+	p->wallUs += endUs - prof_startUs[phase];
+
+	/* Extrapolate multiplexed counts over the time the group was enabled */
+	enabled -= prof_startEnabled[phase];
+	running -= prof_startRunning[phase];
+	scale = (running > 0) ? (double)enabled / running : 0.0;
+	for(x = 0; x < PROF_NUM_CTRS; x++)
+		p->ctr[x] += (unsigned long long)((endCtr[x] - prof_startCtr[phase][x])*scale + 0.5);
+	p->enabledNs += enabled;
+	p->runningNs += running;
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_print - Displays a table of per-phase statistics.                    */
+/*****************************************************************************/
+static void prof_print(const char* label, profStats* pStats){
+
+	int x;
+	profPhase sum;
+	double bytes = (pStats->numBytes > 0) ? (double)pStats->numBytes : 1.0;
+
+	memset(&sum,0,sizeof(sum));
+	printf("Profile: %s (%llu bytes)\n",label,pStats->numBytes);
+	if(prof_hwCtrs)
+		printf("  %-8s %12s %14s %10s %6s %8s\n",
+			"phase","time(us)","cycles","cyc/byte","IPC","brmiss%");
+	else
+		printf("  %-8s %12s %10s\n","phase","time(us)","MB/s");
+
+	for(x = 0; x <= PROF_NUM_PHASES; x++){
+		profPhase* p;
+		const char* name;
+		int y;
+
+		if(x < PROF_NUM_PHASES){
+			p = &pStats->phase[x];
+			name = prof_phaseNames[x];
+			sum.wallUs += p->wallUs;
+			for(y = 0; y < PROF_NUM_CTRS; y++)
+				sum.ctr[y] += p->ctr[y];
+			sum.enabledNs += p->enabledNs;
+			sum.runningNs += p->runningNs;
+		}
+		else{
+			p = &sum;
+			name = "total";
+		}
+
+		if(prof_hwCtrs){
+			double ipc = (p->ctr[PROF_CTR_CYCLES] > 0) ?
+				(double)p->ctr[PROF_CTR_INSTRS] / p->ctr[PROF_CTR_CYCLES] : 0.0;
+			double miss = (p->ctr[PROF_CTR_BRANCHES] > 0) ?
+				100.0 * p->ctr[PROF_CTR_BRMISSES] / p->ctr[PROF_CTR_BRANCHES] : 0.0;
+			printf("  %-8s %12.1f %14llu %10.2f %6.2f %8.2f\n",name,p->wallUs,
+				p->ctr[PROF_CTR_CYCLES],p->ctr[PROF_CTR_CYCLES]/bytes,ipc,miss);
+		}
+		else{
+			double mbps = (p->wallUs > 0.0) ? bytes / p->wallUs : 0.0;
+			printf("  %-8s %12.1f %10.2f\n",name,p->wallUs,mbps);
+		}
+	}
+
+	/* Counts were estimated if the group was not always on the PMU */
+	if(prof_hwCtrs && (sum.runningNs < sum.enabledNs)){
+		printf("  counters multiplexed, on the PMU %.1f%% of the time, counts scaled\n",
+			(sum.enabledNs > 0) ? 100.0 * sum.runningNs / sum.enabledNs : 0.0);
+	}
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_file_done - Reports statistics for the file just processed and adds  */
+/*                  them to the aggregate totals.                            */
+/*****************************************************************************/
+void prof_file_done(const char* fname, size_t numBytes){
+
+	int x, y;
+
+	if(!prof_on)
+		return;
+
+	prof_file.numBytes = numBytes;
+	prof_file.numFiles = 1;
+	prof_print(fname,&prof_file);
+
+	for(x = 0; x < PROF_NUM_PHASES; x++){
+		prof_total.phase[x].wallUs += prof_file.phase[x].wallUs;
+		for(y = 0; y < PROF_NUM_CTRS; y++)
+			prof_total.phase[x].ctr[y] += prof_file.phase[x].ctr[y];
+		prof_total.phase[x].enabledNs += prof_file.phase[x].enabledNs;
+		prof_total.phase[x].runningNs += prof_file.phase[x].runningNs;
+	}
+	prof_total.numBytes += numBytes;
+	prof_total.numFiles++;
+	memset(&prof_file,0,sizeof(prof_file));
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* prof_report_aggregate - Reports totals across all files processed.        */
+/*                         Only displayed when more than one file was run.   */
+/*****************************************************************************/
+void prof_report_aggregate(){
+
+	char label[64];
+
+	if(!prof_on || (prof_total.numFiles < 2))
+		return;
+
+	sprintf(label,"aggregate of %d files",prof_total.numFiles);
+	prof_print(label,&prof_total);
+
+	return;
+}
@@ -0,0 +1,25 @@
+/*****************************************************************************/
+/* profile.h - Per-phase timing and hardware counter profiling.              */
+/*****************************************************************************/
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+
+//Defines
+#define PROF_PHASE_READ    0   //Input file read
+#define PROF_PHASE_ENCODE  1   //RLE encoding
+#define PROF_PHASE_HEADER  2   //Header construction
+#define PROF_PHASE_WRITE   3   //Output file write
+#define PROF_NUM_PHASES    4
+
+//Fctn Prototypes
+int  prof_init();
+void prof_shutdown();
+int  prof_enabled();
+void prof_begin(int phase);
+void prof_end(int phase);
+void prof_file_done(const char* fname, size_t numBytes);
+void prof_report_aggregate();
+
+#endif
@@ -0,0 +1,486 @@
+/*****************************************************************************/
+/* server.c - Persistent local job server and thin client.                   */
+/*            The server listens on a Unix domain socket and runs each       */
+/*            forwarded job in-process, so batches of small compressions do  */
+/*            not pay for a fork/exec and cold start every time.  The client */
+/*            forwards its working directory and arguments, echoes the job's */
+/*            console output and returns the job's exit code.                */
+/*****************************************************************************/
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Job Protocol (host byte order, local socket only)                        //
+//                                                                           //
+// Request:   | magic | cwd | argc | argv[0] ... argv[argc-1] |              //
+//            Integers are 32-bit, strings are a 32-bit length then bytes.   //
+//                                                                           //
+// Response:  | console text | 0x00 | 32-bit job return value |              //
+///////////////////////////////////////////////////////////////////////////////
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "server.h"
+#ifndef _WIN32
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+/* Defines */
+#define SRV_MAGIC        0x4A504D43   /* "CMPJ" */
+#define SRV_MAX_ARGS     256
+#define SRV_MAX_STRLEN   4096
+#define SRV_END_OF_TEXT  0x00
+#define SRV_BACKLOG      64
+#define SRV_IO_TIMEOUT   10           /* Seconds a client may stall a job */
+
+
+#ifndef _WIN32
+
+/* Globals */
+static volatile sig_atomic_t srv_stop = 0;
+
+
+
+
+/*****************************************************************************/
+/* srv_sigHandler - Requests that the server loop exit.                      */
+/*****************************************************************************/
+static void srv_sigHandler(int sig){
+	(void)sig;
+	srv_stop = 1;
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_writeAll - Writes an entire buffer to a socket.                       */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int srv_writeAll(int fd, const void* buf, size_t len){
+
+	const char* p = (const char*)buf;
+	ssize_t rval;
+
+	while(len > 0){
+		rval = write(fd,p,len);
+		if(rval < 0){
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += rval;
+		len -= (size_t)rval;
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_readAll - Reads exactly len bytes from a socket.                      */
+/* Returns: 0 on success, -1 on failure or early end of stream.              */
+/*****************************************************************************/
+static int srv_readAll(int fd, void* buf, size_t len){
+
+	char* p = (char*)buf;
+	ssize_t rval;
+
+	while(len > 0){
+		rval = read(fd,p,len);
+		if(rval < 0){
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		if(rval == 0)
+			return -1;
+		p += rval;
+		len -= (size_t)rval;
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_sendStr - Sends a length-prefixed string.                             */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int srv_sendStr(int fd, const char* str){
+
+	unsigned int len = (unsigned int)strlen(str);
+
+	if(srv_writeAll(fd,&len,sizeof(len)) < 0)
+		return -1;
+	return srv_writeAll(fd,str,len);
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_recvStr - Receives a length-prefixed string.                          */
+/* Returns: malloced, NULL terminated string on success, NULL on failure.    */
+/*****************************************************************************/
+static char* srv_recvStr(int fd){
+
+	unsigned int len;
+	char* str;
+
+	if(srv_readAll(fd,&len,sizeof(len)) < 0)
+		return NULL;
+	if(len > SRV_MAX_STRLEN)
+		return NULL;
+	str = (char*)malloc(len+1);
+	if(str == NULL)
+		return NULL;
+	if(srv_readAll(fd,str,len) < 0){
+		free(str);
+		return NULL;
+	}
+	str[len] = '\0';
+
+	return str;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_makeAddr - Fills in a Unix domain socket address.                     */
+/* Returns: 0 on success, -1 if the path is too long.                        */
+/*****************************************************************************/
+static int srv_makeAddr(const char* sockPath, struct sockaddr_un* addr){
+
+	memset(addr,0,sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if(strlen(sockPath) >= sizeof(addr->sun_path)){
+		printf("Error, socket path too long: %s\n",sockPath);
+		return -1;
+	}
+	strcpy(addr->sun_path,sockPath);
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_connect - Connects to a job server.                                   */
+/* Returns: socket descriptor on success, -1 on failure.                     */
+/*****************************************************************************/
+static int srv_connect(const char* sockPath){
+
+	struct sockaddr_un addr;
+	int fd;
+
+	if(srv_makeAddr(sockPath,&addr) < 0)
+		return -1;
+	fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(fd < 0)
+		return -1;
+	if(connect(fd,(struct sockaddr*)&addr,sizeof(addr)) < 0){
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_handleJob - Receives a single job, runs it with stdout redirected to  */
+/*                 the client, then sends back the job's return value.       */
+/* Returns: 1 if shutdown was requested, 0 otherwise.                        */
+/*****************************************************************************/
+static int srv_handleJob(int conn, srvJobFn jobFn, const char* srvCwd){
+
+	unsigned int magic, argc, x;
+	char* cwd = NULL;
+	char** argv = NULL;
+	char endOfText = SRV_END_OF_TEXT;
+	int rval, savedFd, shutdown;
+
+	rval = -1;
+	shutdown = 0;
+	argc = 0;
+
+	/* Receive the job */
+	if( (srv_readAll(conn,&magic,sizeof(magic)) < 0) || (magic != SRV_MAGIC) )
+		return 0;
+	cwd = srv_recvStr(conn);
+	if( (cwd == NULL) || (srv_readAll(conn,&argc,sizeof(argc)) < 0) ||
+		(argc < 1) || (argc > SRV_MAX_ARGS) ){
+		free(cwd);
+		return 0;
+	}
+	argv = (char**)calloc(argc+1,sizeof(char*));
+	if(argv == NULL){
+		free(cwd);
+		return 0;
+	}
+	for(x = 0; x < argc; x++){
+		argv[x] = srv_recvStr(conn);
+		if(argv[x] == NULL)
+			goto cleanup;
+	}
+
+	/* Shutdown request */
+	if((argc >= 2) && (strcmp(argv[1],"--shutdown") == 0)){
+		const char* msg = "Job server shutting down\n";
+		srv_writeAll(conn,msg,strlen(msg));
+		rval = 0;
+		shutdown = 1;
+	}
+
+	/* Run the job from the client's working directory */
+	else if(chdir(cwd) < 0){
+		const char* msg = "Error, job server cannot access working directory\n";
+		srv_writeAll(conn,msg,strlen(msg));
+	}
+	else{
+		fflush(stdout);
+		savedFd = dup(STDOUT_FILENO);
+		dup2(conn,STDOUT_FILENO);
+		rval = jobFn((int)argc,argv);
+		fflush(stdout);
+		dup2(savedFd,STDOUT_FILENO);
+		close(savedFd);
+		if(chdir(srvCwd) < 0)
+			printf("Warning, unable to restore server working directory\n");
+	}
+
+	/* Terminate the console text and send the return value */
+	if(srv_writeAll(conn,&endOfText,1) == 0)
+		srv_writeAll(conn,&rval,sizeof(rval));
+
+cleanup:
+	for(x = 0; x < argc; x++)
+		free(argv[x]);
+	free(argv);
+	free(cwd);
+
+	return shutdown;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_serve - Runs the job server until a shutdown request or signal.       */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+int srv_serve(const char* sockPath, srvJobFn jobFn){
+
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	struct stat st;
+	struct timeval tv;
+	static char srvCwd[PATH_MAX];
+	mode_t oldMask;
+	int lfd, conn, rval;
+
+	if(srv_makeAddr(sockPath,&addr) < 0)
+		return -1;
+	if(getcwd(srvCwd,sizeof(srvCwd)) == NULL){
+		printf("Error, unable to determine working directory\n");
+		return -1;
+	}
+
+	/* Remove a stale socket left behind by a previous server */
+	if((stat(sockPath,&st) == 0) && S_ISSOCK(st.st_mode)){
+		conn = srv_connect(sockPath);
+		if(conn >= 0){
+			close(conn);
+			printf("Error, a job server is already running on %s\n",sockPath);
+			return -1;
+		}
+		unlink(sockPath);
+	}
+
+	/* Create the listening socket */
+	lfd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(lfd < 0){
+		printf("Error creating socket\n");
+		return -1;
+	}
+
+	/* Jobs write files as the server's user, so only that user may connect */
+	oldMask = umask(0077);
+	rval = bind(lfd,(struct sockaddr*)&addr,sizeof(addr));
+	umask(oldMask);
+	if( (rval < 0) || (chmod(sockPath,0600) < 0) ||
+		(listen(lfd,SRV_BACKLOG) < 0) ){
+		printf("Error, unable to listen on %s\n",sockPath);
+		close(lfd);
+		if(rval == 0)
+			unlink(sockPath);
+		return -1;
+	}
+
+	/* Exit cleanly on SIGINT/SIGTERM, and survive clients that disconnect */
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler = srv_sigHandler;
+	sigaction(SIGINT,&sa,NULL);
+	sigaction(SIGTERM,&sa,NULL);
+	signal(SIGPIPE,SIG_IGN);
+
+	printf("Job server listening on %s\n",sockPath);
+	fflush(stdout);
+
+	/* Run jobs one at a time, in arrival order */
+	while(!srv_stop){
+		conn = accept(lfd,NULL,NULL);
+		if(conn < 0){
+			if(errno == EINTR)
+				continue;
+			printf("Error accepting connection\n");
+			break;
+		}
+
+		/* A stalled client must not hold up the jobs queued behind it */
+		tv.tv_sec = SRV_IO_TIMEOUT;
+		tv.tv_usec = 0;
+		setsockopt(conn,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+		setsockopt(conn,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+		if(srv_handleJob(conn,jobFn,srvCwd))
+			srv_stop = 1;
+		close(conn);
+	}
+
+	close(lfd);
+	unlink(sockPath);
+	printf("Job server stopped\n");
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_client - Forwards a job to the server and echoes its console output.  */
+/*              Runs the job locally if the server cannot be reached.        */
+/* Returns: the job's return value.                                          */
+/*****************************************************************************/
+int srv_client(const char* sockPath, int argc, char** argv, srvJobFn jobFn){
+
+	static char cwd[PATH_MAX];
+	char buf[4096];
+	char* pEnd;
+	unsigned int magic, u_argc;
+	int fd, x, rval, rvalBytes;
+	ssize_t len;
+
+	fd = srv_connect(sockPath);
+	if(fd < 0){
+		if((argc >= 2) && (strcmp(argv[1],"--shutdown") == 0)){
+			printf("No job server running on %s\n",sockPath);
+			return -1;
+		}
+		printf("Job server unavailable, running locally\n");
+		return jobFn(argc,argv);
+	}
+	if(getcwd(cwd,sizeof(cwd)) == NULL){
+		printf("Error, unable to determine working directory\n");
+		close(fd);
+		return -1;
+	}
+
+	/* Send the job */
+	magic = SRV_MAGIC;
+	u_argc = (unsigned int)argc;
+	if( (srv_writeAll(fd,&magic,sizeof(magic)) < 0) ||
+		(srv_sendStr(fd,cwd) < 0) ||
+		(srv_writeAll(fd,&u_argc,sizeof(u_argc)) < 0) ){
+		printf("Error sending job to server\n");
+		close(fd);
+		return -1;
+	}
+	for(x = 0; x < argc; x++){
+		if(srv_sendStr(fd,argv[x]) < 0){
+			printf("Error sending job to server\n");
+			close(fd);
+			return -1;
+		}
+	}
+
+	/* Echo console text up to the terminator, then collect the return value */
+	rval = -1;
+	rvalBytes = -1;
+	while((len = read(fd,buf,sizeof(buf))) != 0){
+		if(len < 0){
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		if(rvalBytes < 0){
+			pEnd = (char*)memchr(buf,SRV_END_OF_TEXT,(size_t)len);
+			if(pEnd == NULL){
+				fwrite(buf,1,(size_t)len,stdout);
+				continue;
+			}
+			fwrite(buf,1,(size_t)(pEnd-buf),stdout);
+			rvalBytes = 0;
+			len -= (pEnd+1) - buf;
+			memmove(buf,pEnd+1,(size_t)len);
+		}
+		for(x = 0; (x < len) && (rvalBytes < (int)sizeof(rval)); x++)
+			((char*)&rval)[rvalBytes++] = buf[x];
+		if(rvalBytes == (int)sizeof(rval))
+			break;
+	}
+	close(fd);
+
+	if(rvalBytes != (int)sizeof(rval)){
+		printf("Error, lost connection to job server\n");
+		return -1;
+	}
+
+	return rval;
+}
+
+
+#else
+
+
+/*****************************************************************************/
+/* srv_serve - Unix domain sockets are not available on this platform.       */
+/*****************************************************************************/
+int srv_serve(const char* sockPath, srvJobFn jobFn){
+	(void)sockPath;
+	(void)jobFn;
+	printf("Error, job server is not supported on this platform\n");
+	return -1;
+}
+
+
+
+
+/*****************************************************************************/
+/* srv_client - Always runs the job locally on this platform.                */
+/*****************************************************************************/
+int srv_client(const char* sockPath, int argc, char** argv, srvJobFn jobFn){
+	(void)sockPath;
+	return jobFn(argc,argv);
+}
+
+#endif
@@ -0,0 +1,14 @@
+/*****************************************************************************/
+/* server.h - Persistent local job server and thin client.                   */
+/*****************************************************************************/
+#ifndef SERVER_H
+#define SERVER_H
+
+//Job entry point, called with the same arguments as main()
+typedef int (*srvJobFn)(int argc, char** argv);
+
+//Fctn Prototypes
+int srv_serve(const char* sockPath, srvJobFn jobFn);
+int srv_client(const char* sockPath, int argc, char** argv, srvJobFn jobFn);
+
+#endif
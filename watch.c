@@ -0,0 +1,738 @@
+/*****************************************************************************/
+/* watch.c - Watches an asset tree and recompresses files as they change.    */
+/*           inotify reports finished writes anywhere under the source       */
+/*           directory.  Each changed file waits until it has been quiet for */
+/*           WATCH_DEBOUNCE_MS, so bursts of writes cost one compression,    */
+/*           then goes to a pool of worker threads.  Workers keep their      */
+/*           input and output buffers between jobs, and each output is       */
+/*           written to a temporary file and renamed into place so readers   */
+/*           never see a partial file.                                       */
+/*****************************************************************************/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress_rtns.h"
+#include "watch.h"
+#ifdef __linux__
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#endif
+
+
+#ifdef __linux__
+
+/* Defines */
+#define WATCH_EVENT_MASK       (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+#define WATCH_EVENT_BUF_BYTES  (64*1024)
+#define WATCH_PATH_BYTES       4096
+#define WATCH_ST_PENDING       0      /* Waiting out the debounce time */
+#define WATCH_ST_BUSY          1      /* Queued for or held by a worker */
+
+/* A changed source file */
+typedef struct watchFile{
+	char*   relPath;
+	int     state;
+	int     rerun;             /* Changed again while busy */
+	int     rval;
+	double  lastEventUs;       /* Most recent change */
+	double  jobEventUs;        /* Change the current job answers */
+	double  startUs;           /* Picked up by a worker */
+	double  doneUs;            /* Output renamed into place */
+	size_t  inBytes;
+	size_t  outBytes;
+	struct watchFile* next;    /* All changed files */
+	struct watchFile* qNext;   /* Job or done queue */
+}watchFile;
+
+/* Buffers a worker keeps between jobs */
+typedef struct{
+	char*  pIn;
+	size_t inCapBytes;
+	char*  pOut;
+	size_t outCapBytes;
+}watchBufs;
+
+/* State shared by the watcher and the workers */
+typedef struct{
+	char*  srcDir;
+	char*  outDir;
+	char   outRealPath[PATH_MAX];
+	off_t  fileOffset;
+	size_t dataSizeBytes;
+	int    cmprType;
+	int    forceHdrSize32;
+	int    inotifyFd;
+	int    wakeFds[2];          /* Workers wake the watcher when done */
+	char** wdPaths;             /* Relative directory of each watch */
+	int    numWdPaths;
+	int    numDirs;
+	int    numQueued;
+	watchFile* files;
+	watchFile* jobHead, *jobTail;
+	watchFile* doneHead, *doneTail;
+	int    shutdown;
+	pthread_mutex_t lock;
+	pthread_cond_t  jobReady;
+	unsigned long   numChanges;
+	unsigned long   numErrors;
+	double sumLatencyUs;
+	double maxLatencyUs;
+}watchCtx;
+
+/* Globals */
+static volatile sig_atomic_t watch_stop = 0;
+
+
+
+
+/*****************************************************************************/
+/* watch_sigHandler - Requests that the watch loop exit.                     */
+/*****************************************************************************/
+static void watch_sigHandler(int sig){
+	(void)sig;
+	watch_stop = 1;
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_nowUs - Returns a monotonic timestamp in microseconds.              */
+/*****************************************************************************/
+static double watch_nowUs(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (double)ts.tv_sec*1000000.0 + (double)ts.tv_nsec/1000.0;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_joinPath - Joins a directory and a name, either may be empty.       */
+/* Returns: 0 on success, -1 if the path is too long.                        */
+/*****************************************************************************/
+static int watch_joinPath(char* buf, const char* dir, const char* name,
+						  const char* ext)
+{
+	int len;
+
+	if(dir[0] == '\0')
+		len = snprintf(buf,WATCH_PATH_BYTES,"%s%s",name,ext);
+	else if(name[0] == '\0')
+		len = snprintf(buf,WATCH_PATH_BYTES,"%s%s",dir,ext);
+	else
+		len = snprintf(buf,WATCH_PATH_BYTES,"%s/%s%s",dir,name,ext);
+	if((len < 0) || (len >= WATCH_PATH_BYTES)){
+		printf("Error, path too long: %s/%s\n",dir,name);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_mkdirs - Creates the missing parent directories of a file path.     */
+/* Returns: 0 on success, -1 on failure.                                     */
+/*****************************************************************************/
+static int watch_mkdirs(const char* filePath){
+
+	char path[WATCH_PATH_BYTES];
+	char* p;
+
+	strcpy(path,filePath);
+	for(p = path + 1; *p != '\0'; p++){
+		if(*p != '/')
+			continue;
+		*p = '\0';
+		if((mkdir(path,0777) != 0) && (errno != EEXIST)){
+			printf("Error creating directory %s\n",path);
+			return -1;
+		}
+		*p = '/';
+	}
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_markChanged - Records a change to a source file.                    */
+/*****************************************************************************/
+static void watch_markChanged(watchCtx* ctx, const char* relPath, double nowUs){
+
+	watchFile* file;
+
+	for(file = ctx->files; file != NULL; file = file->next){
+		if(strcmp(file->relPath,relPath) == 0)
+			break;
+	}
+
+	/* Already known, restart its debounce time */
+	if(file != NULL){
+		file->lastEventUs = nowUs;
+		if(file->state == WATCH_ST_BUSY)
+			file->rerun = 1;
+		return;
+	}
+
+	file = (watchFile*)calloc(1,sizeof(watchFile));
+	if(file != NULL)
+		file->relPath = (char*)malloc(strlen(relPath)+1);
+	if((file == NULL) || (file->relPath == NULL)){
+		printf("Error allocating memory for %s\n",relPath);
+		free(file);
+		return;
+	}
+	strcpy(file->relPath,relPath);
+	file->state = WATCH_ST_PENDING;
+	file->lastEventUs = nowUs;
+	file->next = ctx->files;
+	ctx->files = file;
+	ctx->numQueued++;
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_addTree - Watches a source directory and everything below it.       */
+/*                 At startup only files whose output is missing or older    */
+/*                 are queued; a directory that appears later is queued in   */
+/*                 full, since its files may have been written before the    */
+/*                 watch was added.                                          */
+/* Returns: 0 on success, -1 if the directory cannot be watched.             */
+/*****************************************************************************/
+static int watch_addTree(watchCtx* ctx, const char* relDir, int startup,
+						 double nowUs)
+{
+	char dirPath[WATCH_PATH_BYTES], path[WATCH_PATH_BYTES];
+	char relPath[WATCH_PATH_BYTES], outPath[WATCH_PATH_BYTES];
+	char realPath[PATH_MAX];
+	struct stat st, outSt;
+	struct dirent* ent;
+	DIR* dir;
+	int wd;
+
+	if(watch_joinPath(dirPath,ctx->srcDir,relDir,"") < 0)
+		return -1;
+
+	/* Never watch our own outputs */
+	if((realpath(dirPath,realPath) != NULL) &&
+		(strcmp(realPath,ctx->outRealPath) == 0))
+		return 0;
+
+	wd = inotify_add_watch(ctx->inotifyFd,dirPath,WATCH_EVENT_MASK);
+	if(wd < 0){
+		printf("Error watching %s (%s)\n",dirPath,strerror(errno));
+		return -1;
+	}
+	if(wd >= ctx->numWdPaths){
+		int newNum = (wd + 1)*2;
+		char** tmp = (char**)realloc(ctx->wdPaths,newNum*sizeof(char*));
+		if(tmp == NULL){
+			printf("Error allocating memory for watch list\n");
+			return -1;
+		}
+		memset(tmp + ctx->numWdPaths,0,(newNum - ctx->numWdPaths)*sizeof(char*));
+		ctx->wdPaths = tmp;
+		ctx->numWdPaths = newNum;
+	}
+	if(ctx->wdPaths[wd] == NULL)
+		ctx->numDirs++;
+	free(ctx->wdPaths[wd]);
+	ctx->wdPaths[wd] = (char*)malloc(strlen(relDir)+1);
+	if(ctx->wdPaths[wd] == NULL){
+		printf("Error allocating memory for watch list\n");
+		return -1;
+	}
+	strcpy(ctx->wdPaths[wd],relDir);
+
+	dir = opendir(dirPath);
+	if(dir == NULL){
+		printf("Error opening directory %s\n",dirPath);
+		return -1;
+	}
+	while((ent = readdir(dir)) != NULL){
+		if((strcmp(ent->d_name,".") == 0) || (strcmp(ent->d_name,"..") == 0))
+			continue;
+		if((watch_joinPath(relPath,relDir,ent->d_name,"") < 0) ||
+			(watch_joinPath(path,ctx->srcDir,relPath,"") < 0))
+			continue;
+
+		/* Symbolic links are not followed */
+		if(lstat(path,&st) != 0)
+			continue;
+		if(S_ISDIR(st.st_mode))
+			watch_addTree(ctx,relPath,startup,nowUs);
+		else if(S_ISREG(st.st_mode)){
+			if(startup){
+				if((watch_joinPath(outPath,ctx->outDir,relPath,WATCH_OUT_EXT) == 0) &&
+					(stat(outPath,&outSt) == 0) && ((outSt.st_mtime > st.st_mtime) ||
+					((outSt.st_mtime == st.st_mtime) &&
+					(cmp_mtime_nsec(&outSt) >= cmp_mtime_nsec(&st)))))
+					continue;
+			}
+			watch_markChanged(ctx,relPath,nowUs);
+		}
+	}
+	closedir(dir);
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_compressFile - Compresses one source file using a worker's warm     */
+/*                      buffers and renames the output into place.           */
+/* Returns: 0 on success, 1 if the file is gone, -1 on failure.              */
+/*****************************************************************************/
+static int watch_compressFile(watchCtx* ctx, watchBufs* bufs, watchFile* file){
+
+	char inPath[WATCH_PATH_BYTES], outPath[WATCH_PATH_BYTES];
+	char tmpPath[WATCH_PATH_BYTES];
+	char* pHdr;
+	cmpInput input;
+	size_t sizeBytes, maxCmprSizeBytes, cmprSizeBytes;
+	int hdrSizeBytes, rval;
+
+	if((watch_joinPath(inPath,ctx->srcDir,file->relPath,"") < 0) ||
+		(watch_joinPath(outPath,ctx->outDir,file->relPath,WATCH_OUT_EXT) < 0) ||
+		(watch_joinPath(tmpPath,ctx->outDir,file->relPath,WATCH_OUT_EXT ".tmp") < 0))
+		return -1;
+
+	/* Read the input into the warm buffer, growing it only when needed */
+	rval = cmp_read_input_buf(inPath,ctx->fileOffset,ctx->dataSizeBytes,
+		&bufs->pIn,&bufs->inCapBytes,&input);
+	if(rval != 0)
+		return rval;
+	sizeBytes = input.sizeBytes;
+	maxCmprSizeBytes = cmp_max_cmpr_size(sizeBytes,ctx->cmprType);
+
+	/* Encode into the warm output buffer, header goes in front */
+	if((CMP_MAX_HDR_BYTES + maxCmprSizeBytes) > bufs->outCapBytes){
+		char* tmp = (char*)realloc(bufs->pOut,CMP_MAX_HDR_BYTES + maxCmprSizeBytes);
+		if(tmp == NULL){
+			printf("Error allocating memory for %s\n",outPath);
+			return -1;
+		}
+		bufs->pOut = tmp;
+		bufs->outCapBytes = CMP_MAX_HDR_BYTES + maxCmprSizeBytes;
+	}
+	if(cmp_encode_into(bufs->pIn,sizeBytes,ctx->cmprType,
+		bufs->pOut + CMP_MAX_HDR_BYTES,maxCmprSizeBytes,&cmprSizeBytes) < 0)
+		return -1;
+	pHdr = cmp_prepend_header(bufs->pOut,ctx->cmprType,sizeBytes,
+		ctx->forceHdrSize32,&hdrSizeBytes);
+	if(pHdr == NULL)
+		return -1;
+
+	/* Replace the output atomically */
+	if((watch_mkdirs(outPath) < 0) ||
+		(cmp_write_output(tmpPath,pHdr,hdrSizeBytes + cmprSizeBytes) < 0))
+		return -1;
+	if(rename(tmpPath,outPath) != 0){
+		printf("Error replacing %s\n",outPath);
+		remove(tmpPath);
+		return -1;
+	}
+	file->inBytes = sizeBytes;
+	file->outBytes = hdrSizeBytes + cmprSizeBytes;
+
+	return 0;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_worker - Pool thread, compresses queued files until shutdown.       */
+/*****************************************************************************/
+static void* watch_worker(void* arg){
+
+	watchCtx* ctx = (watchCtx*)arg;
+	watchBufs bufs;
+	watchFile* file;
+	char wake = 0;
+
+	memset(&bufs,0,sizeof(bufs));
+	while(1){
+		pthread_mutex_lock(&ctx->lock);
+		while((ctx->jobHead == NULL) && !ctx->shutdown)
+			pthread_cond_wait(&ctx->jobReady,&ctx->lock);
+		file = ctx->jobHead;
+		if(file != NULL){
+			ctx->jobHead = file->qNext;
+			if(ctx->jobHead == NULL)
+				ctx->jobTail = NULL;
+		}
+		pthread_mutex_unlock(&ctx->lock);
+		if(file == NULL)
+			break;
+
+		file->startUs = watch_nowUs();
+		file->rval = watch_compressFile(ctx,&bufs,file);
+		file->doneUs = watch_nowUs();
+
+		/* Hand the result back to the watcher */
+		pthread_mutex_lock(&ctx->lock);
+		file->qNext = NULL;
+		if(ctx->doneTail != NULL)
+			ctx->doneTail->qNext = file;
+		else
+			ctx->doneHead = file;
+		ctx->doneTail = file;
+		pthread_mutex_unlock(&ctx->lock);
+		if(write(ctx->wakeFds[1],&wake,1) < 0){
+			/* Pipe already full, the watcher is being woken anyway */
+		}
+	}
+	free(bufs.pIn);
+	free(bufs.pOut);
+
+	return NULL;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_dispatch - Queues files whose debounce time has passed.             */
+/* Returns: milliseconds until the next file is due, -1 if none are waiting. */
+/*****************************************************************************/
+static int watch_dispatch(watchCtx* ctx, double nowUs){
+
+	watchFile* file;
+	double dueUs, nextDueUs = -1.0;
+
+	for(file = ctx->files; file != NULL; file = file->next){
+		if(file->state != WATCH_ST_PENDING)
+			continue;
+		dueUs = file->lastEventUs + WATCH_DEBOUNCE_MS*1000.0;
+		if(dueUs > nowUs){
+			if((nextDueUs < 0.0) || (dueUs < nextDueUs))
+				nextDueUs = dueUs;
+			continue;
+		}
+		file->state = WATCH_ST_BUSY;
+		file->rerun = 0;
+		file->jobEventUs = file->lastEventUs;
+		pthread_mutex_lock(&ctx->lock);
+		file->qNext = NULL;
+		if(ctx->jobTail != NULL)
+			ctx->jobTail->qNext = file;
+		else
+			ctx->jobHead = file;
+		ctx->jobTail = file;
+		pthread_cond_signal(&ctx->jobReady);
+		pthread_mutex_unlock(&ctx->lock);
+	}
+	if(nextDueUs < 0.0)
+		return -1;
+
+	return (int)((nextDueUs - nowUs)/1000.0) + 1;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_reap - Reports finished files and releases or re-arms them.         */
+/*****************************************************************************/
+static void watch_reap(watchCtx* ctx){
+
+	watchFile* done, *file, **pLink;
+	double latencyUs;
+	char drain[256];
+
+	while(read(ctx->wakeFds[0],drain,sizeof(drain)) > 0);
+
+	pthread_mutex_lock(&ctx->lock);
+	done = ctx->doneHead;
+	ctx->doneHead = ctx->doneTail = NULL;
+	pthread_mutex_unlock(&ctx->lock);
+
+	while(done != NULL){
+		file = done;
+		done = done->qNext;
+
+		/* Latency runs from the last change seen to the rename.  A file */
+		/* renamed or deleted before it was compressed is skipped.       */
+		latencyUs = file->doneUs - file->jobEventUs;
+		if(file->rval < 0){
+			ctx->numChanges++;
+			ctx->numErrors++;
+			printf("%s: failed\n",file->relPath);
+		}
+		else if(file->rval == 0){
+			ctx->numChanges++;
+			ctx->sumLatencyUs += latencyUs;
+			if(latencyUs > ctx->maxLatencyUs)
+				ctx->maxLatencyUs = latencyUs;
+			printf("%s: %lu -> %lu bytes, %.2f ms after change (%.2f ms compressing)\n",
+				file->relPath,(unsigned long)file->inBytes,
+				(unsigned long)file->outBytes,latencyUs/1000.0,
+				(file->doneUs - file->startUs)/1000.0);
+		}
+		fflush(stdout);
+
+		/* Changed again while busy, wait out a new debounce time */
+		if(file->rerun){
+			file->state = WATCH_ST_PENDING;
+			continue;
+		}
+		for(pLink = &ctx->files; *pLink != file; pLink = &(*pLink)->next);
+		*pLink = file->next;
+		free(file->relPath);
+		free(file);
+	}
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_handleEvents - Reads inotify events and records the changes.        */
+/*****************************************************************************/
+static void watch_handleEvents(watchCtx* ctx){
+
+	static char buf[WATCH_EVENT_BUF_BYTES]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	char relPath[WATCH_PATH_BYTES];
+	struct inotify_event* ev;
+	ssize_t len;
+	double nowUs;
+	char* p;
+
+	len = read(ctx->inotifyFd,buf,sizeof(buf));
+	if(len <= 0)
+		return;
+	nowUs = watch_nowUs();
+
+	for(p = buf; p < (buf + len); p += sizeof(struct inotify_event) + ev->len){
+		ev = (struct inotify_event*)p;
+
+		/* Events were lost, fall back to comparing timestamps */
+		if(ev->mask & IN_Q_OVERFLOW){
+			printf("Warning, change events were lost, rescanning %s\n",ctx->srcDir);
+			watch_addTree(ctx,"",1,nowUs);
+			continue;
+		}
+		if((ev->wd < 0) || (ev->wd >= ctx->numWdPaths) ||
+			(ctx->wdPaths[ev->wd] == NULL))
+			continue;
+
+		/* Directory was removed */
+		if(ev->mask & IN_IGNORED){
+			free(ctx->wdPaths[ev->wd]);
+			ctx->wdPaths[ev->wd] = NULL;
+			ctx->numDirs--;
+			continue;
+		}
+		if((ev->len == 0) ||
+			(watch_joinPath(relPath,ctx->wdPaths[ev->wd],ev->name,"") < 0))
+			continue;
+
+		if(ev->mask & IN_ISDIR){
+			if(ev->mask & (IN_CREATE | IN_MOVED_TO))
+				watch_addTree(ctx,relPath,0,nowUs);
+		}
+		else if(ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			watch_markChanged(ctx,relPath,nowUs);
+	}
+
+	return;
+}
+
+
+
+
+/*****************************************************************************/
+/* watch_run - Keeps compressed outputs up to date with a source tree until  */
+/*             interrupted.  Each file under srcDir is compressed to the     */
+/*             same relative path under outDir with WATCH_OUT_EXT appended.  */
+/* Inputs: srcDir, root of the asset tree to watch                           */
+/*         outDir, root of the output tree, created if needed                */
+/*         fileOffset/dataSizeBytes/cmprType/forceHdrSize32, as for a single */
+/*         file                                                              */
+/* Returns: 0 if every compression succeeded, -1 otherwise.                  */
+/*****************************************************************************/
+int watch_run(char* srcDir, char* outDir, off_t fileOffset,
+			  size_t dataSizeBytes, int cmprType, int forceHdrSize32)
+{
+	watchCtx ctx;
+	watchFile* file;
+	pthread_t workers[WATCH_MAX_WORKERS];
+	struct sigaction sa, oldInt, oldTerm;
+	int ownInt, ownTerm;
+	struct pollfd fds[2];
+	long numCpus;
+	int numWorkers, timeoutMs, watching, x, rval;
+
+	memset(&ctx,0,sizeof(ctx));
+	ctx.srcDir = srcDir;
+	ctx.outDir = outDir;
+	ctx.fileOffset = fileOffset;
+	ctx.dataSizeBytes = dataSizeBytes;
+	ctx.cmprType = cmprType;
+	ctx.forceHdrSize32 = forceHdrSize32;
+	ctx.wakeFds[0] = ctx.wakeFds[1] = -1;
+
+	if(((mkdir(outDir,0777) != 0) && (errno != EEXIST)) ||
+		(realpath(outDir,ctx.outRealPath) == NULL)){
+		printf("Error creating output directory %s\n",outDir);
+		return -1;
+	}
+	ctx.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(ctx.inotifyFd < 0){
+		printf("Error starting inotify (%s)\n",strerror(errno));
+		return -1;
+	}
+	if(pipe(ctx.wakeFds) != 0){
+		printf("Error creating watch wake pipe\n");
+		close(ctx.inotifyFd);
+		return -1;
+	}
+	fcntl(ctx.wakeFds[0],F_SETFL,O_NONBLOCK);
+	fcntl(ctx.wakeFds[1],F_SETFL,O_NONBLOCK);
+	pthread_mutex_init(&ctx.lock,NULL);
+	pthread_cond_init(&ctx.jobReady,NULL);
+
+	/* Stop cleanly on Ctrl-C, without restarting poll().  Signals a */
+	/* host process already handles (or ignores) are left alone.     */
+	watch_stop = 0;
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler = watch_sigHandler;
+	sigemptyset(&sa.sa_mask);
+	ownInt = (sigaction(SIGINT,NULL,&oldInt) == 0) && (oldInt.sa_handler == SIG_DFL);
+	ownTerm = (sigaction(SIGTERM,NULL,&oldTerm) == 0) && (oldTerm.sa_handler == SIG_DFL);
+	if(ownInt)
+		sigaction(SIGINT,&sa,NULL);
+	if(ownTerm)
+		sigaction(SIGTERM,&sa,NULL);
+
+	/* One worker per CPU */
+	numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+	numWorkers = (numCpus < 1) ? 1 : (numCpus > WATCH_MAX_WORKERS) ?
+		WATCH_MAX_WORKERS : (int)numCpus;
+	for(x = 0; x < numWorkers; x++){
+		if(pthread_create(&workers[x],NULL,watch_worker,&ctx) != 0){
+			printf("Error starting watch worker\n");
+			break;
+		}
+	}
+	numWorkers = x;
+
+	/* Watch the tree and queue anything out of date */
+	rval = (numWorkers > 0) ? watch_addTree(&ctx,"",1,watch_nowUs()) : -1;
+	watching = (rval == 0);
+	if(watching){
+		printf("Watching %s -> %s: %d directories, %d files out of date, "
+			"%d workers (Ctrl-C to stop)\n",srcDir,outDir,ctx.numDirs,
+			ctx.numQueued,numWorkers);
+		fflush(stdout);
+	}
+
+	while((rval == 0) && !watch_stop){
+		timeoutMs = watch_dispatch(&ctx,watch_nowUs());
+		fds[0].fd = ctx.inotifyFd;
+		fds[0].events = POLLIN;
+		fds[1].fd = ctx.wakeFds[0];
+		fds[1].events = POLLIN;
+		if(poll(fds,2,timeoutMs) < 0){
+			if(errno == EINTR)
+				continue;
+			printf("Error waiting for changes (%s)\n",strerror(errno));
+			rval = -1;
+			break;
+		}
+		if(fds[0].revents & POLLIN)
+			watch_handleEvents(&ctx);
+		if(fds[1].revents & POLLIN)
+			watch_reap(&ctx);
+	}
+
+	/* Finish the files already handed to workers */
+	pthread_mutex_lock(&ctx.lock);
+	ctx.shutdown = 1;
+	pthread_cond_broadcast(&ctx.jobReady);
+	pthread_mutex_unlock(&ctx.lock);
+	for(x = 0; x < numWorkers; x++)
+		pthread_join(workers[x],NULL);
+	watch_reap(&ctx);
+
+	if(watching){
+		printf("Watch stopped: %lu changes, %lu errors",ctx.numChanges,ctx.numErrors);
+		if(ctx.numChanges > ctx.numErrors)
+			printf(", latency mean %.2f ms, max %.2f ms",
+				ctx.sumLatencyUs/1000.0/(ctx.numChanges - ctx.numErrors),
+				ctx.maxLatencyUs/1000.0);
+		printf("\n");
+	}
+
+	/* Free Resources */
+	if(ownInt)
+		sigaction(SIGINT,&oldInt,NULL);
+	if(ownTerm)
+		sigaction(SIGTERM,&oldTerm,NULL);
+	while(ctx.files != NULL){
+		file = ctx.files;
+		ctx.files = file->next;
+		free(file->relPath);
+		free(file);
+	}
+	for(x = 0; x < ctx.numWdPaths; x++)
+		free(ctx.wdPaths[x]);
+	free(ctx.wdPaths);
+	pthread_mutex_destroy(&ctx.lock);
+	pthread_cond_destroy(&ctx.jobReady);
+	close(ctx.wakeFds[0]);
+	close(ctx.wakeFds[1]);
+	close(ctx.inotifyFd);
+
+	if((rval < 0) || (ctx.numErrors > 0))
+		return -1;
+
+	return 0;
+}
+
+
+#else
+
+
+/*****************************************************************************/
+/* watch_run - Watch mode needs inotify.                                     */
+/*****************************************************************************/
+int watch_run(char* srcDir, char* outDir, off_t fileOffset,
+			  size_t dataSizeBytes, int cmprType, int forceHdrSize32)
+{
+	(void)srcDir; (void)outDir; (void)fileOffset;
+	(void)dataSizeBytes; (void)cmprType; (void)forceHdrSize32;
+	printf("Error, watch mode is only supported on Linux\n");
+	return -1;
+}
+
+#endif
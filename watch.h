@@ -0,0 +1,19 @@
+/*****************************************************************************/
+/* watch.h - Watches an asset tree and recompresses files as they change.    */
+/*****************************************************************************/
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+//Defines
+#define WATCH_OUT_EXT       ".cmp"  //Appended to each source path for its output
+#define WATCH_DEBOUNCE_MS   20      //Quiet time before a changed file is compressed
+#define WATCH_MAX_WORKERS   8
+
+//Fctn Prototypes
+int watch_run(char* srcDir, char* outDir, off_t fileOffset,
+			  size_t dataSizeBytes, int cmprType, int forceHdrSize32);
+
+#endif